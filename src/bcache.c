@@ -0,0 +1,296 @@
+/* This file manages the buffer cache of the disk blocks
+ *
+ * A didactic simulation of an arm OS running on the uarm emulator.
+ * Copyright (C) 2016 Carlo De Pieri, Alessio Koci, Gianmaria Pedrini,
+ * Alessio Trivisonno
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// project specific consts and types, includes uARM consts and types
+#include <const.h>
+#include <types.h>
+// phase 1 libs
+#include <asl.h>
+#include <clist.h>
+#include <dlist.h>
+#include <helplib.h>
+#include <kmem.h>
+// phase 2 libs
+#include <exceptions.h>
+#include <bcache.h>
+// uARM libs
+#include <libuarm.h>
+#include <arch.h>
+
+#ifdef DEBUG
+#include <debug.h>
+#endif
+
+extern int softblock_count;
+extern struct dev_desc dev_table[DEV_USED_INTS][DEV_PER_INT];
+extern struct kmem_cache ioreq_cache;
+
+// the buffers, bufs_used of them have a page and are in lru_list
+static struct buf bufs[DISK_CACHE_BUFS];
+static int bufs_used = 0;
+// buffers in use, least recently used first
+static struct dlist lru_list = DLIST_INIT;
+// TRUE if a write back on the disk failed since the last DISKSYNC
+static bool sync_error[DEV_PER_INT];
+// operations of the cache in progress or queued on each disk
+static int disk_ops[DEV_PER_INT];
+
+/* Return the descriptor of disk, or NULL if it's not installed */
+static struct dev_desc* disk_desc(unsigned int disk){
+    if (disk >= DEV_PER_INT)
+        return NULL;
+    struct dev_desc* desc = &(dev_table[IL_DISK-INT_LOWEST][disk]);
+    if ((char)desc->reg->dtp.status == DEV_NOT_INSTALLED)
+        return NULL;
+    return desc;
+}
+
+/* Return TRUE if block is a block of the disk of desc */
+static bool disk_has_block(struct dev_desc *desc, unsigned int block){
+    // DATA1 is MAXCYL << 16 | MAXHEAD << 8 | MAXSECT
+    unsigned int geometry = desc->reg->dtp.data1;
+    return block < (geometry >> 16) * ((geometry >> 8) & 0xFF) * (geometry & 0xFF);
+}
+
+/* Return the command of the next step of the operation on b, on the disk of desc: the seek
+ * to the cylinder of its block first, then the read or write of the block */
+static unsigned int buf_command(struct dev_desc *desc, struct buf *b){
+    unsigned int geometry = desc->reg->dtp.data1;
+    unsigned int sectors = geometry & 0xFF;
+    unsigned int heads = (geometry >> 8) & 0xFF;
+    if (!b->b_seeked)
+        return ((b->b_block / (sectors * heads)) << 8) | DEV_DISK_C_SEEKCYL;
+    unsigned int head = (b->b_block / sectors) % heads;
+    unsigned int sector = b->b_block % sectors;
+    return (head << 16) | (sector << 8) |
+        ((b->b_state == BUF_WRITE) ? DEV_DISK_C_WRITEBLK : DEV_DISK_C_READBLK);
+}
+
+/* Start reading the block of b from its disk, or writing it back if write is TRUE.
+ * The seek is sent now if the disk is free, otherwise it's queued. If there's no memory to
+ * queue it the operation fails at once: b is in BUF_ERROR (or back in BUF_VALID, for a write) */
+static void buf_start(struct buf *b, bool write){
+    struct dev_desc* desc = &(dev_table[IL_DISK-INT_LOWEST][b->b_disk]);
+    b->b_state = write ? BUF_WRITE : BUF_READ;
+    b->b_seeked = FALSE;
+    unsigned int command = buf_command(desc, b);
+    if (clist_empty(desc->rq[TERM_TRASM]) && io_start(desc, TERM_TRASM, command) == IO_DONE){
+        desc->buf_op = b;
+        disk_ops[b->b_disk]++;
+        softblock_count++;
+        return;
+    }
+    struct io_req* req = kmem_alloc(&ioreq_cache);
+    if (req == NULL){
+        if (write){
+            b->b_state = BUF_VALID;
+            b->b_dirty = FALSE;
+            sync_error[b->b_disk] = TRUE;
+        }
+        else
+            b->b_state = BUF_ERROR;
+        return;
+    }
+    req->rq = &(desc->rq[TERM_TRASM]);
+    req->command = command;
+    req->pid = 0;
+    req->async = FALSE;
+    req->buf = b;
+    clist_enqueue(req, req->rq, link);
+    disk_ops[b->b_disk]++;
+    softblock_count++;
+}
+
+/* TRUE if an operation on b is in progress or queued */
+static bool buf_busy(struct buf *b){
+    return b->b_state == BUF_READ || b->b_state == BUF_WRITE;
+}
+
+/* Put the calling process on wait for the end of the operation on b */
+static int buf_wait(struct buf *b){
+    if (sys_semaphoreop(&(b->b_sem), -1) != SEM_PROCESS_ON_WAIT)
+        // error, nobody releases the semaphore of a buffer
+        PANIC();
+    return DISK_WAIT;
+}
+
+/* Return the buffer of block of disk, as the most recently used one. If the block is not
+ * cached a buffer is taken for it (in BUF_EMPTY): a new one while there are less than
+ * DISK_CACHE_BUFS, otherwise the least recently used clean one which is not busy.
+ * If there's no such buffer return NULL and put in wait the one to wait for: the least
+ * recently used dirty buffer, whose write back is started, or the least recently used one if
+ * they are all busy. wait is NULL too if there's no memory for the cache. */
+static struct buf* buf_get(unsigned int disk, unsigned int block, struct buf **wait){
+    struct buf *b, *tmp, *dirty = NULL;
+    *wait = NULL;
+    dlist_foreach(b, &lru_list, b_lru, tmp){
+        if (b->b_disk == disk && b->b_block == block){
+            dlist_delete(b, &lru_list, b_lru);
+            dlist_enqueue(b, &lru_list, b_lru);
+            return b;
+        }
+    }
+    b = NULL;
+    if (bufs_used < DISK_CACHE_BUFS && (bufs[bufs_used].b_data = kmem_page_alloc()) != NULL)
+        b = &(bufs[bufs_used++]);
+    else {
+        dlist_foreach(b, &lru_list, b_lru, tmp){
+            if (buf_busy(b))
+                continue;
+            if (!b->b_dirty){
+                dlist_delete(b, &lru_list, b_lru);
+                break;
+            }
+            if (dirty == NULL)
+                dirty = b;
+        }
+    }
+    if (b != NULL){
+        b->b_disk = disk;
+        b->b_block = block;
+        b->b_state = BUF_EMPTY;
+        b->b_dirty = FALSE;
+        dlist_enqueue(b, &lru_list, b_lru);
+        return b;
+    }
+    if (dirty != NULL){
+        buf_start(dirty, TRUE);
+        if (buf_busy(dirty))
+            *wait = dirty;
+        else
+            // the write back failed at once, the buffer is clean now
+            return buf_get(disk, block, wait);
+    }
+    else if (!dlist_empty(lru_list))
+        *wait = dlist_head(b, lru_list, b_lru);
+    return NULL;
+}
+
+/* DISKREAD: copy block of disk into the DISK_BLOCK_SIZE bytes at buf.
+ * Return DISK_OK, DISK_ERROR if there's no such block or the disk read failed, or DISK_WAIT
+ * if the calling process has been put on wait */
+int bcache_read(unsigned int disk, unsigned int block, void *buf){
+    struct dev_desc* desc = disk_desc(disk);
+    if (desc == NULL || !disk_has_block(desc, block))
+        return DISK_ERROR;
+    struct buf *b, *wait;
+    if ((b = buf_get(disk, block, &wait)) == NULL)
+        return (wait != NULL) ? buf_wait(wait) : DISK_ERROR;
+    switch (b->b_state) {
+        case BUF_VALID:
+            mymemcopy(b->b_data, buf, DISK_BLOCK_SIZE);
+            return DISK_OK;
+        case BUF_ERROR:
+            // the read this process was waiting for failed, the next one tries again
+            b->b_state = BUF_EMPTY;
+            return DISK_ERROR;
+        case BUF_EMPTY:
+            buf_start(b, FALSE);
+            if (b->b_state == BUF_ERROR){
+                b->b_state = BUF_EMPTY;
+                return DISK_ERROR;
+            }
+            return buf_wait(b);
+        default:
+            return buf_wait(b);
+    }
+}
+
+/* DISKWRITE: copy the DISK_BLOCK_SIZE bytes at buf into block of disk, which is written back
+ * later. Return DISK_OK, DISK_ERROR if there's no such block or no memory for the cache,
+ * or DISK_WAIT */
+int bcache_write(unsigned int disk, unsigned int block, void *buf){
+    struct dev_desc* desc = disk_desc(disk);
+    if (desc == NULL || !disk_has_block(desc, block))
+        return DISK_ERROR;
+    struct buf *b, *wait;
+    if ((b = buf_get(disk, block, &wait)) == NULL)
+        return (wait != NULL) ? buf_wait(wait) : DISK_ERROR;
+    if (buf_busy(b))
+        return buf_wait(b);
+    // the whole block is written, there's no need to read it first
+    mymemcopy(buf, b->b_data, DISK_BLOCK_SIZE);
+    b->b_state = BUF_VALID;
+    b->b_dirty = TRUE;
+    return DISK_OK;
+}
+
+/* DISKSYNC: write back the dirty blocks of disk, one at a time. Return DISK_OK once they are
+ * all on the disk, DISK_ERROR if there's no such disk or some write back failed since the
+ * last DISKSYNC, or DISK_WAIT */
+int bcache_sync(unsigned int disk){
+    if (disk_desc(disk) == NULL)
+        return DISK_ERROR;
+    struct buf *b, *tmp;
+    dlist_foreach(b, &lru_list, b_lru, tmp){
+        if (b->b_disk != disk)
+            continue;
+        if (b->b_state == BUF_WRITE)
+            return buf_wait(b);
+        if (b->b_dirty && b->b_state == BUF_VALID){
+            buf_start(b, TRUE);
+            if (buf_busy(b))
+                return buf_wait(b);
+        }
+    }
+    bool failed = sync_error[disk];
+    sync_error[disk] = FALSE;
+    return failed ? DISK_ERROR : DISK_OK;
+}
+
+/* TRUE if the cache is using the disk of desc: it has an operation in progress or queued on it.
+ * DATA0 belongs to the cache then, so IODEVOP can't use the disk */
+bool bcache_busy(struct dev_desc *desc){
+    return disk_ops[desc->dev] > 0;
+}
+
+/* Called by the interrupt handler when the command of the buffer cache operation in progress
+ * on the disk of desc is over, with the disk already acknowledged, or when the disk didn't take
+ * it (status is not DEV_S_READY then). Return TRUE if the next command of the operation has
+ * been sent, FALSE if the operation is over: the buffer is released and its waiters woken up */
+bool bcache_io_done(struct dev_desc *desc, unsigned int status){
+    struct buf* b = desc->buf_op;
+    bool ok = ((char)status == DEV_S_READY);
+    if (ok && !b->b_seeked){
+        // the head is on the cylinder of the block, now transfer it
+        b->b_seeked = TRUE;
+        desc->reg->dtp.data0 = (memaddr) b->b_data;
+        if (io_start(desc, TERM_TRASM, buf_command(desc, b)) == IO_DONE)
+            return TRUE;
+        // no interrupt will come for it, the operation failed
+        ok = FALSE;
+    }
+    desc->buf_op = NULL;
+    disk_ops[b->b_disk]--;
+    softblock_count--;
+    if (b->b_state == BUF_WRITE){
+        // the data is still good even if the disk doesn't have it: DISKSYNC tells
+        if (!ok)
+            sync_error[b->b_disk] = TRUE;
+        b->b_state = BUF_VALID;
+        b->b_dirty = FALSE;
+    }
+    else
+        b->b_state = ok ? BUF_VALID : BUF_ERROR;
+    // wake up everyone waiting for the buffer, they will issue their SYSCALL again
+    while (headBlocked(&(b->b_sem)) != NULL)
+        sys_semaphoreop(&(b->b_sem), 1);
+    return FALSE;
+}
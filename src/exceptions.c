@@ -25,10 +25,14 @@
 #include <pcb.h>
 #include <asl.h>
 #include <clist.h>
+#include <dlist.h>
 #include <helplib.h>
+#include <kmem.h>
 // phase 2 libs
 #include <exceptions.h>
 #include <scheduler.h>
+#include <interrupts.h>
+#include <bcache.h>
 // uARM libs
 #include <libuarm.h>
 
@@ -36,13 +40,25 @@
 #include <debug.h>
 #endif
 
-extern struct clist *ready_queue;
 extern int proc_count;
-extern bool free_pidmap[MAXPROC];
+extern struct pid_entry *pid_dir[PID_DIR_SIZE];
+extern int pid_slots;
+extern int pid_free_head;
+extern int pid_free_tail;
+extern struct kmem_cache pcb_cache;
+extern struct kmem_cache semd_cache;
+extern struct kmem_cache excp_cache;
+extern struct kmem_cache iocq_cache;
+// device requests waiting for their device
+struct kmem_cache ioreq_cache;
+
+// slot i of the pid table
+#define PID_ENTRY(i) (&(pid_dir[(i) / PID_CHUNK_SIZE][(i) % PID_CHUNK_SIZE]))
 extern int softblock_count;
 extern struct pcb_t *curr_proc;
 extern int s_term_array[DEV_PER_INT][TERM_SUBDEV];
 extern int s_dev_array[DEV_USED_INTS-1][DEV_PER_INT];
+extern struct dev_desc dev_table[DEV_USED_INTS][DEV_PER_INT];
 extern int s_pseudo_clock_timer;
 
 /* This is the syscall system handler.
@@ -64,7 +80,7 @@ void Syscall_Handler() {
      * nucleus should perform one of the services described below.
      * else se non è in kernel mode va gestito come indicato in 3.3.12 */
 
-    if (sys_num >= SYSCALL_MIN && sys_num <= SYSCALL_MAX) {
+    if (IS_NUCLEUS_SYSCALL(sys_num)) {
         // if the last bit of cpsr is 0 we are in usermode
 
         if (! (oldarea->cpsr & 0x0F)) { // if the last bit of cpsr is 0 we are in usermode
@@ -80,19 +96,34 @@ void Syscall_Handler() {
                     {{
                          int result = sys_createprocess((state_t*)oldarea->a2);
                          oldarea->a1 = result;
-                         // restore parent process into the processor
+                         // restore parent process into the processor, unless the child has
+                         // an higher priority
                          update_sys_time(oldarea->TOD_Low, curr_proc);
-                         LDST(oldarea);
+                         resume_or_preempt(oldarea);
                      }}
                     break;
 
-                case TERMINATEPROCESS:
-                    // we set the timer to an high enough value to avoid an interrupt before the scheduler 
-                    // gets the chance to reset it for the next process (it would lose its next time slice),
-                    // but low enough that if the ready queue is empty we dont miss the pseudo clock timer tick
-                    // by too much
-                    if (oldarea->a2 == 0) setTIMER(SCHED_TIME_SLICE);
+                case SETTIMESLICE:
+                    oldarea->a1 = sys_settimeslice((cputime_t)oldarea->a2);
+                    update_sys_time(oldarea->TOD_Low, curr_proc);
+                    // the new time slice is used from the next dispatch on
+                    LDST(oldarea);
+                    break;
+
+                case SETTICKETS:
+                    oldarea->a1 = sys_settickets(oldarea->a2);
+                    update_sys_time(oldarea->TOD_Low, curr_proc);
+                    LDST(oldarea);
+                    break;
 
+                case SETREALTIME:
+                    oldarea->a1 = sys_setrealtime((cputime_t)oldarea->a2, (cputime_t)oldarea->a3);
+                    update_sys_time(oldarea->TOD_Low, curr_proc);
+                    // a process leaving the real time class can be preempted by a real time one
+                    resume_or_preempt(oldarea);
+                    break;
+
+                case TERMINATEPROCESS:
                     // call the recursive murderer function
                     sys_terminateprocess(oldarea->a2, curr_proc);
                     if (curr_proc==NULL){
@@ -102,12 +133,20 @@ void Syscall_Handler() {
                     else {
                         // the calling process only killed a child, it should continue
                         update_sys_time(oldarea->TOD_Low, curr_proc);
-                        LDST(oldarea);
+                        resume_or_preempt(oldarea);
                     }
                     break;
 
                 case SEMOP:
                     {{
+                         // a4 is the timeout of a P: SEMOP_FOREVER, SEMOP_TRY or microseconds
+                         unsigned int timeout = oldarea->a4;
+                         if (timeout == SEMOP_TRY && (int)oldarea->a3 < 0 &&
+                                 sem_would_block((int*)oldarea->a2, (int)oldarea->a3)){
+                             oldarea->a1 = SEMOP_WOULDBLOCK;
+                             update_sys_time(oldarea->TOD_Low, curr_proc);
+                             LDST(oldarea);
+                         }
                          int result = sys_semaphoreop((int*)oldarea->a2,(int)oldarea->a3);
                          switch (result) {
                              case SEM_PROCESS_SCHEDULE_NEW:
@@ -115,12 +154,19 @@ void Syscall_Handler() {
                                  schedule(SCHED_PROC_KILLED);
                                  break;
                              case SEM_PROCESS_GO_ON:
+                                 oldarea->a1 = SEMOP_OK;
                                  update_sys_time(oldarea->TOD_Low, curr_proc);
-                                 LDST(oldarea);
+                                 // a V could have woken up an higher priority process
+                                 resume_or_preempt(oldarea);
                                  break;
                              case SEM_PROCESS_ON_WAIT:
                                  update_sys_time(oldarea->TOD_Low, curr_proc);
+                                 // the timer changes it to SEMOP_TIMEDOUT if the P times out
+                                 oldarea->a1 = SEMOP_OK;
                                  curr_proc->p_s = *((state_t*)(oldarea));
+                                 if (timeout != SEMOP_FOREVER)
+                                     sleep_insert(curr_proc, timeout > SCHED_SLEEP_MAX ? SCHED_SLEEP_MAX : timeout);
+                                 sched_blocked(curr_proc, FALSE);
                                  schedule(SCHED_PROC_BLOCKED); 
                                  break;
                              default:
@@ -131,6 +177,48 @@ void Syscall_Handler() {
                      }}
                     break;
 
+                case KMEMSTAT:
+                    oldarea->a1 = sys_kmemstat((int)oldarea->a2, (struct kmem_stats*)oldarea->a3);
+                    update_sys_time(oldarea->TOD_Low, curr_proc);
+                    LDST(oldarea);
+                    break;
+
+                case SEMOPV:
+                    {{
+                         int result = sys_semaphoreopv((struct semop_t*)oldarea->a2, (int)oldarea->a3);
+                         switch (result) {
+                             case SEM_PROCESS_SCHEDULE_NEW:
+                                 // if a weight was 0 and the process has been terminated
+                                 schedule(SCHED_PROC_KILLED);
+                                 break;
+                             case SEM_PROCESS_GO_ON:
+                                 oldarea->a1 = 0;
+                                 update_sys_time(oldarea->TOD_Low, curr_proc);
+                                 // a V could have woken up an higher priority process
+                                 resume_or_preempt(oldarea);
+                                 break;
+                             case SEM_PROCESS_ON_WAIT:
+                                 update_sys_time(oldarea->TOD_Low, curr_proc);
+                                 curr_proc->p_s = *((state_t*)(oldarea));
+                                 // once woken up the process issues the same SYSCALL again,
+                                 // to perform the rest of the vector
+                                 curr_proc->p_s.pc -= 4; // size of the SWI instruction
+                                 sched_blocked(curr_proc, FALSE);
+                                 schedule(SCHED_PROC_BLOCKED);
+                                 break;
+                             case SEM_PROCESS_ERROR:
+                                 oldarea->a1 = SEMOPV_ERROR;
+                                 update_sys_time(oldarea->TOD_Low, curr_proc);
+                                 LDST(oldarea);
+                                 break;
+                             default:
+                                 //error
+                                 PANIC();
+                                 break;
+                         }
+                     }}
+                    break;
+
                 case SPECSYSHDL:
                     {{
                          //the address of the handler function in a2, the address of the handler’s stack in a3 and the execution flags in a4.
@@ -194,15 +282,20 @@ void Syscall_Handler() {
                 case EXITTRAP:
                     {{
                          state_t* pcb_oldarea;
+                         if (curr_proc->p_excp == NULL){
+                             // no handler was ever defined, there's no trap to exit from
+                             sys_terminateprocess(0, curr_proc);
+                             schedule(SCHED_PROC_KILLED);
+                         }
                          switch (oldarea->a2) {
                              case EXCP_SYS_OLD:
-                                 pcb_oldarea = &(curr_proc->p_excpvec[EXCP_SYS_OLD]);
+                                 pcb_oldarea = &(curr_proc->p_excp->p_excpvec[EXCP_SYS_OLD]);
                                  break;
                              case EXCP_TLB_OLD:
-                                 pcb_oldarea = &(curr_proc->p_excpvec[EXCP_TLB_OLD]);
+                                 pcb_oldarea = &(curr_proc->p_excp->p_excpvec[EXCP_TLB_OLD]);
                                  break;
                              case EXCP_PGMT_OLD:
-                                 pcb_oldarea = &(curr_proc->p_excpvec[EXCP_PGMT_OLD]);
+                                 pcb_oldarea = &(curr_proc->p_excp->p_excpvec[EXCP_PGMT_OLD]);
                                  break;
                              default:
                                  //error
@@ -225,17 +318,41 @@ void Syscall_Handler() {
 
                 case WAITCLOCK:
                     {{
-                         int result = sys_semaphoreop(&s_pseudo_clock_timer, -1);
-                         if (result == SEM_PROCESS_ON_WAIT){
-                             softblock_count++;
+                         if (IS_RT(curr_proc)){
+                             // a real time process ends its job and waits for its next period
                              curr_proc->p_s = *((state_t*)(oldarea));
                              update_sys_time(oldarea->TOD_Low, curr_proc);
-                             schedule(SCHED_PROC_BLOCKED); 
+                             rt_charge(curr_proc);
+                             rt_wait_next_period(curr_proc);
+                             schedule(SCHED_PROC_BLOCKED);
                          }
-                         else {
-                             //error, the process should always lock on the timer sem
-                             PANIC();
+                         // ticks nobody waited for were skipped, the first waiter must wait
+                         // for the next one
+                         if (headBlocked(&s_pseudo_clock_timer) == NULL)
+                             pseudo_clock_sync(getTODLO());
+                         dev_wait(&s_pseudo_clock_timer);
+                         curr_proc->p_s = *((state_t*)(oldarea));
+                         update_sys_time(oldarea->TOD_Low, curr_proc);
+                         sched_blocked(curr_proc, TRUE);
+                         schedule(SCHED_PROC_BLOCKED); 
+                     }}
+                    break;
+
+                case SLEEP:
+                    {{
+                         if (oldarea->a2 == 0 || oldarea->a2 > SCHED_SLEEP_MAX){
+                             // nothing to wait for, or too much
+                             oldarea->a1 = (oldarea->a2 == 0) ? 0 : SLEEP_ERROR;
+                             update_sys_time(oldarea->TOD_Low, curr_proc);
+                             LDST(oldarea);
                          }
+                         oldarea->a1 = 0;
+                         curr_proc->p_s = *((state_t*)(oldarea));
+                         update_sys_time(oldarea->TOD_Low, curr_proc);
+                         // sleeping is not waiting for I/O, MLFQ doesn't boost it
+                         sched_blocked(curr_proc, FALSE);
+                         sleep_insert(curr_proc, oldarea->a2);
+                         schedule(SCHED_PROC_BLOCKED);
                      }}
                     break;
 
@@ -256,6 +373,7 @@ void Syscall_Handler() {
                              case IO_PROCESS_ON_WAIT:
                                 curr_proc->p_s = *((state_t*)(oldarea));
                                 update_sys_time(oldarea->TOD_Low, curr_proc);
+                                sched_blocked(curr_proc, TRUE);
                                 schedule(SCHED_PROC_BLOCKED);
                                 break;
                              default:
@@ -266,12 +384,132 @@ void Syscall_Handler() {
                     }}
                     break;
 
+                case TERMWRITE:
+                    {{
+                        if (oldarea->a4 == 0){
+                            // nothing to write
+                            oldarea->a1 = 0;
+                            update_sys_time(oldarea->TOD_Low, curr_proc);
+                            LDST(oldarea);
+                        }
+                        int result = sys_termwrite(oldarea->a2, (char*)oldarea->a3, oldarea->a4);
+                        if (result == IO_PROCESS_ON_WAIT){
+                            // a1 will be the number of characters transmitted
+                            curr_proc->p_s = *((state_t*)(oldarea));
+                            update_sys_time(oldarea->TOD_Low, curr_proc);
+                            sched_blocked(curr_proc, TRUE);
+                            schedule(SCHED_PROC_BLOCKED);
+                        }
+                        else {
+                            oldarea->a1 = TERMWRITE_ERROR;
+                            update_sys_time(oldarea->TOD_Low, curr_proc);
+                            LDST(oldarea);
+                        }
+                    }}
+                    break;
+
+                case TERMREAD:
+                    {{
+                        unsigned int done = 0;
+                        int result = IO_DONE;
+                        if (oldarea->a4 != 0)
+                            result = sys_termread(oldarea->a2, (char*)oldarea->a3, oldarea->a4, &done);
+                        switch (result) {
+                            case IO_PROCESS_ON_WAIT:
+                                // a1 counts the characters read: terminal_handler() goes on
+                                // from there, while a3 and a4 still hold the buffer and its size
+                                oldarea->a1 = done;
+                                curr_proc->p_s = *((state_t*)(oldarea));
+                                update_sys_time(oldarea->TOD_Low, curr_proc);
+                                sched_blocked(curr_proc, TRUE);
+                                schedule(SCHED_PROC_BLOCKED);
+                                break;
+                            case IO_DONE:
+                                oldarea->a1 = done;
+                                update_sys_time(oldarea->TOD_Low, curr_proc);
+                                LDST(oldarea);
+                                break;
+                            default:
+                                oldarea->a1 = TERMREAD_ERROR;
+                                update_sys_time(oldarea->TOD_Low, curr_proc);
+                                LDST(oldarea);
+                                break;
+                        }
+                    }}
+                    break;
+
+                case IODEVOPASYNC:
+                    oldarea->a1 = sys_iodevop_async(oldarea->a2, oldarea->a3, oldarea->a4);
+                    update_sys_time(oldarea->TOD_Low, curr_proc);
+                    LDST(oldarea);
+                    break;
+
+                case IOREAP:
+                    {{
+                        struct io_cq* cq = curr_proc->p_iocq;
+                        if (cq == NULL || cq->pending == 0){
+                            // nothing to reap, nor to wait for
+                            oldarea->a1 = (oldarea->a3) ? IOREAP_ERROR : 0;
+                        }
+                        else if (cq->count == 0 && oldarea->a3){
+                            // wait for the next completion: the interrupt handler will reap it
+                            // into the buffer in a2, then wake up the process
+                            cq->waiting = TRUE;
+                            softblock_count++;
+                            curr_proc->p_s = *((state_t*)(oldarea));
+                            update_sys_time(oldarea->TOD_Low, curr_proc);
+                            sched_blocked(curr_proc, TRUE);
+                            schedule(SCHED_PROC_BLOCKED);
+                        }
+                        else {
+                            oldarea->a1 = io_reap(cq, (struct io_completion*)oldarea->a2);
+                        }
+                        update_sys_time(oldarea->TOD_Low, curr_proc);
+                        LDST(oldarea);
+                    }}
+                    break;
+
+                case DISKREAD:
+                case DISKWRITE:
+                case DISKSYNC:
+                    {{
+                        int result;
+                        if (sys_num == DISKREAD)
+                            result = bcache_read(oldarea->a2, oldarea->a3, (void*)oldarea->a4);
+                        else if (sys_num == DISKWRITE)
+                            result = bcache_write(oldarea->a2, oldarea->a3, (void*)oldarea->a4);
+                        else
+                            result = bcache_sync(oldarea->a2);
+                        if (result == DISK_WAIT){
+                            update_sys_time(oldarea->TOD_Low, curr_proc);
+                            curr_proc->p_s = *((state_t*)(oldarea));
+                            // once woken up the process issues the same SYSCALL again: the
+                            // block is in the cache then, or the buffer it waited for is free
+                            curr_proc->p_s.pc -= 4; // size of the SWI instruction
+                            sched_blocked(curr_proc, TRUE);
+                            schedule(SCHED_PROC_BLOCKED);
+                        }
+                        oldarea->a1 = result;
+                        update_sys_time(oldarea->TOD_Low, curr_proc);
+                        LDST(oldarea);
+                    }}
+                    break;
+
                 case GETPID:
                     oldarea->a1 = getPID(); 
                     update_sys_time(oldarea->TOD_Low, curr_proc);
                     LDST(oldarea);
                     break;
 
+                case SETPRIORITY:
+                    {{
+                         oldarea->a1 = sys_setpriority((int)oldarea->a2);
+                         update_sys_time(oldarea->TOD_Low, curr_proc);
+                         // if the process lowered its priority someone else could be entitled to run
+                         resume_or_preempt(oldarea);
+                     }}
+                    break;
+
                 default:
                     //error
                     PANIC();
@@ -280,18 +518,18 @@ void Syscall_Handler() {
         } //PGMT else parenthesis
     } //if parenthesis
     else if (sys_num > 11){
-        if (curr_proc->handler_defined[CHECK_SYS_HDL]){
-            curr_proc->p_excpvec[EXCP_SYS_OLD] = *oldarea;
-            curr_proc->p_excpvec[EXCP_SYS_NEW].a1 = oldarea->a1;
-            curr_proc->p_excpvec[EXCP_SYS_NEW].a2 = oldarea->a2;
-            curr_proc->p_excpvec[EXCP_SYS_NEW].a3 = oldarea->a3;
-            curr_proc->p_excpvec[EXCP_SYS_NEW].a4 = oldarea->a4;
+        if (HANDLER_DEFINED(curr_proc, CHECK_SYS_HDL)){
+            curr_proc->p_excp->p_excpvec[EXCP_SYS_OLD] = *oldarea;
+            curr_proc->p_excp->p_excpvec[EXCP_SYS_NEW].a1 = oldarea->a1;
+            curr_proc->p_excp->p_excpvec[EXCP_SYS_NEW].a2 = oldarea->a2;
+            curr_proc->p_excp->p_excpvec[EXCP_SYS_NEW].a3 = oldarea->a3;
+            curr_proc->p_excp->p_excpvec[EXCP_SYS_NEW].a4 = oldarea->a4;
             //reset the higher byte of a1
-            curr_proc->p_excpvec[EXCP_SYS_NEW].a1 &= 0x0FFFFFFF;
+            curr_proc->p_excp->p_excpvec[EXCP_SYS_NEW].a1 &= 0x0FFFFFFF;
             //copy the lower byte of cpsr in the higher byte of a1
-            curr_proc->p_excpvec[EXCP_SYS_NEW].a1 |= oldarea->cpsr << 28; //check this
+            curr_proc->p_excp->p_excpvec[EXCP_SYS_NEW].a1 |= oldarea->cpsr << 28; //check this
             update_sys_time(oldarea->TOD_Low, curr_proc);
-            LDST(&(curr_proc->p_excpvec[EXCP_SYS_NEW]));
+            LDST(&(curr_proc->p_excp->p_excpvec[EXCP_SYS_NEW]));
         }
         else {
             //suicide
@@ -306,80 +544,125 @@ void Syscall_Handler() {
  * Helper functions *
  ********************/
 
-/* Create a new pcb, insert it into the ready_queue and return its pid */
+/* Create a new pcb, insert it into the ready queues and return its pid.
+ * The child inherits the priority, the time slice and the tickets of its parent. */
 int sys_createprocess(state_t *statep) {
-    struct pcb_t *p_child = allocPcb();
+    // every field allocPcbLazy() leaves alone is set here
+    struct pcb_t *p_child = allocPcbLazy();
     if (p_child == NULL) {
         return CREATE_PROCESS_ERROR;
     }
-    p_child->p_pid = generatePID();
+    // every process can block on a semaphore nobody else uses: keep a semaphore descriptor
+    // for each pcb, so that insertBlocked() never runs out of memory
+    if (!kmem_cache_reserve(&semd_cache, pcb_cache.in_use)) {
+        freePcb(p_child);
+        return CREATE_PROCESS_ERROR;
+    }
+    p_child->p_pid = generatePID(p_child);
+    if (p_child->p_pid == 0) {
+        // the pid table is full
+        freePcb(p_child);
+        return CREATE_PROCESS_ERROR;
+    }
+    p_child->p_prio = curr_proc->p_base_prio;
+    p_child->p_base_prio = curr_proc->p_base_prio;
+    p_child->p_quantum = curr_proc->p_quantum;
+    p_child->p_tickets = curr_proc->p_tickets;
+    // the child starts from where its parent is, as a process waking up would do
+    p_child->p_pass = curr_proc->p_pass;
     insertChild(curr_proc, p_child);
-    insertProcQ(ready_queue, p_child);
+    ready_insert(p_child);
     p_child->p_s = *statep;
     proc_count++;
     return p_child->p_pid;
 }
 
-/* Kill the process with the given pid; start looking for it from pcb */
+/* Kill the process with the given pid, which must be pcb or one of its descendants, and all
+ * of its progeny. pid=0 means pcb itself. */
 void sys_terminateprocess(pid_t pid, struct pcb_t* pcb){
-    // pid=0 means kill itself, otherwise one of its children
-    if((pid == 0) || (pcb->p_pid == pid)){
-        while(!emptyChild(pcb)){
-            sys_terminateprocess(0, removeChild(pcb));
-        }        
-        // we need to remove this pcb from his parent children
-        outChild(pcb);
-        // NOW LET'S KILL SOME PROCESS >:)
-        if(pcb->p_pid != curr_proc->p_pid){
-            // the actual process is not the one who called the SYS2
-            if (pcb->p_cursem != NULL) {
-                if (is_device_sem(pcb->p_cursem->s_semAdd)){
-                    // the process is blocked on a system device semaphore,
-                    // we should only take out the pcb from the sem, while the interrupt handler will
-                    // manage the semaphore value
-                    outBlocked(pcb);
-                    softblock_count--;
-                }
-                else {
-                    // note: this particular implementation depends on our semaphore design
-                    //
-                    // if pcb is blocked on a sem and its not a device semaphore, unblock it (pcb->p_cursem would not be NULL)
-                    if((headBlocked(pcb->p_cursem->s_semAdd)) == pcb){
-                        // we call sys_semaphoreop to manage sem value, since this pcb is HEAD
-                        // s_req_weight is <0, we must flip it before use it with sys_semaphoreop
-                        sys_semaphoreop(pcb->p_cursem->s_semAdd, ((pcb->s_req_weight)*(-1)));
-                        outProcQ(ready_queue, pcb);
-                    }
-                    else {
-                        // the value of the semaphore is unaffected, we can simply remove the process from it
-                        outBlocked(pcb);
-                    }
-                }
+    if(pid != 0){
+        // find the target in the pid table, then check it descends from pcb
+        struct pcb_t* target = pid_lookup(pid);
+        struct pcb_t* scan = target;
+        while(scan != NULL && scan != pcb)
+            scan = scan->p_parent;
+        if(scan == NULL){
+            // stale pid, or not a descendant of pcb: nothing to kill
+            return;
+        }
+        pcb = target;
+    }
+    // we need to remove this pcb from his parent children
+    outChild(pcb);
+    // kill the subtree in post order without recursion, since the kernel stack is small:
+    // go down through the first children to a leaf, kill it and go back to its parent,
+    // which might have become a leaf itself. pcb has no parent now, so the walk ends there.
+    struct pcb_t* p = pcb;
+    while(p != NULL){
+        if(!emptyChild(p)){
+            p = dlist_head(p, p->p_children, p_siblings);
+        }
+        else {
+            struct pcb_t* parent = p->p_parent;
+            // p is the first child of its parent
+            if(parent != NULL)
+                removeChild(parent);
+            kill_pcb(p);
+            p = parent;
+        }
+    }
+}
+
+/* Take a process with no children out of every kernel queue and free it, giving back the
+ * semaphore units it holds in the middle of a SEMOPV */
+void kill_pcb(struct pcb_t* pcb){
+    // a SEMOPV waiter which has already been woken up holds the units of its p_semv_held
+    // operation until it issues the syscall again (a weight 0 in the vector kills it then)
+    struct semop_t* held = (pcb->p_cursem == NULL) ? pcb->p_semv_held : NULL;
+    // NOW LET'S KILL SOME PROCESS >:)
+    if(pcb != curr_proc){
+        // the actual process is not the one who called the SYS2
+        if (pcb->p_cursem != NULL) {
+            if (is_device_sem(pcb->p_cursem->s_semAdd)){
+                if (pcb->p_ioreq != NULL)
+                    // the IODEVOP of the process is still queued: it is dropped
+                    io_cancel(pcb);
+                // the process is blocked on a system device semaphore: if its request is in
+                // progress the interrupt handler will find its owner dead
+                dev_cancel_wait(pcb);
             }
             else {
-                // the process is on the ready_queue, let's delete it
-                outProcQ(ready_queue, pcb);
+                // a timed P also leaves the sleep queue
+                sem_cancel_wait(pcb);
             }
         }
-        else {
-            // the actual process is the one who called the SYS2 and wants to die, this is the only 
-            // case in which we enter here!
-            curr_proc = NULL;
+        else if (pcb->p_sleeping) {
+            sleep_out(pcb);
+        }
+        else if (pcb->p_iocq != NULL && pcb->p_iocq->waiting) {
+            // the process is waiting in IOREAP, it is in no queue: the completions of its
+            // requests will be dropped
+            softblock_count--;
         }
-        free_pidmap[pcb->p_pid] = TRUE;
-        freePcb(pcb);
-        proc_count--;
+        else if (!pcb->p_rt_waiting) {
+            // the process is on a ready queue, let's delete it
+            ready_out(pcb);
+        }
+        // (a real time process waiting for its next period is taken out by rt_leave())
     }
     else {
-        if (!emptyChild(pcb)){
-            void *tmp = NULL;
-            struct pcb_t * scan;
-            // recursively look for a children whose pid is the one we're looking for
-            clist_foreach(scan, &pcb->p_children, p_siblings, tmp){
-                sys_terminateprocess(pid, scan);
-            }
-        }
+        // the actual process is the one who called the SYS2 and wants to die, this is the only 
+        // case in which we enter here!
+        curr_proc = NULL;
     }
+    // give back the utilization of a real time process
+    rt_leave(pcb);
+    // and the units held by a SEMOPV
+    if (held != NULL)
+        sys_semaphoreop(held->semaddr, -(held->weight));
+    releasePID(pcb->p_pid);
+    freePcb(pcb);
+    proc_count--;
 }
 
 /* Check if a pcb is blocked on our device or pseudoclock semaphores.
@@ -409,20 +692,16 @@ int sys_semaphoreop (int *semaddr, int weight){
         // deallocating resources
         *semaddr += weight;
         if(*semaddr>=0 && headBlocked(semaddr)!=NULL){
-            // reset pcb field when freeing the process
-            headBlocked(semaddr)->s_req_weight = 0;
             // we can unblock the first process waiting since we reached 0
-            insertProcQ(ready_queue, removeBlocked(semaddr));
+            sem_wake(removeBlocked(semaddr));
             // now check if we can unblock more processes
             while(*semaddr>=0 && headBlocked(semaddr)!=NULL){
                 // this enters (and goes on) if there are processes blocked on the semaphore
                 // AND if there are enough resources to be allocated
                 int resource_requested = headBlocked(semaddr)->s_req_weight;
                 if((*semaddr + resource_requested) >= 0){
-                    // reset pcb field when freeing the process
-                    headBlocked(semaddr)->s_req_weight = 0;
-                    // return the process to the ready_queue
-                    insertProcQ(ready_queue, removeBlocked(semaddr));
+                    // return the process to its ready queue
+                    sem_wake(removeBlocked(semaddr));
                 }
                 // decrement anyway, 'cause there's a process in queue requesting resources
                 *semaddr += resource_requested;
@@ -435,7 +714,9 @@ int sys_semaphoreop (int *semaddr, int weight){
         if (*semaddr >= 0){
             if (*semaddr + weight < 0){
                 // there are not enough resources, put it on wait
-                insertBlocked(semaddr, curr_proc);
+                if (insertBlocked(semaddr, curr_proc))
+                    // can't happen, there's a semaphore descriptor for each pcb
+                    PANIC();
                 *semaddr += weight;
                 // update pcb of waiting process
                 curr_proc->s_req_weight = weight;
@@ -449,7 +730,8 @@ int sys_semaphoreop (int *semaddr, int weight){
         }
         else {
             // do not decrement, there's already other processes on the semaphore
-            insertBlocked(semaddr, curr_proc);
+            if (insertBlocked(semaddr, curr_proc))
+                PANIC();
             // update pcb of waiting process
             curr_proc->s_req_weight = weight;
             return SEM_PROCESS_ON_WAIT;
@@ -457,21 +739,144 @@ int sys_semaphoreop (int *semaddr, int weight){
     }
 }
 
+/* Perform a vector of n semaphore operations atomically: either all of them are performed,
+ * or none. If some P can't be satisfied the process waits on the first such semaphore and,
+ * once it got it, issues the syscall again for the rest of the vector (p_semv_held).
+ * If the rest still can't be satisfied the held semaphore is released before waiting again,
+ * so the process never waits while holding a part of the vector.
+ * Return SEM_PROCESS_ERROR if n is out of [1, SEMOPV_MAX] or a semaphore is repeated. */
+int sys_semaphoreopv(struct semop_t *ops, int n){
+    int i, j;
+    if (n < 1 || n > SEMOPV_MAX)
+        return SEM_PROCESS_ERROR;
+    for (i = 0; i < n; i++){
+        if (ops[i].weight == 0){
+            // as for SEMOP, weight 0 is treated as a SYS2 of the process itself
+            sys_terminateprocess(0, curr_proc);
+            return SEM_PROCESS_SCHEDULE_NEW;
+        }
+        for (j = 0; j < i; j++)
+            if (ops[j].semaddr == ops[i].semaddr)
+                return SEM_PROCESS_ERROR;
+    }
+    int blocking = semopv_first_blocking(ops, n);
+    if (blocking >= 0 && curr_proc->p_semv_held != NULL){
+        // don't keep a semaphore while waiting for another one
+        struct semop_t *held = curr_proc->p_semv_held;
+        curr_proc->p_semv_held = NULL;
+        sys_semaphoreop(held->semaddr, -(held->weight));
+        blocking = semopv_first_blocking(ops, n);
+    }
+    if (blocking >= 0){
+        // perform none of them, wait on the first semaphore which can't be got now
+        curr_proc->p_semv_held = &ops[blocking];
+        return sys_semaphoreop(ops[blocking].semaddr, ops[blocking].weight);
+    }
+    // every P can be satisfied: no sys_semaphoreop below puts the process on wait
+    for (i = 0; i < n; i++)
+        if (&ops[i] != curr_proc->p_semv_held)
+            sys_semaphoreop(ops[i].semaddr, ops[i].weight);
+    curr_proc->p_semv_held = NULL;
+    return SEM_PROCESS_GO_ON;
+}
+
+/* Return the index of the first P of a SEMOPV vector which would put the process on wait,
+ * or -1 if all of them can be satisfied now. The held operation is already performed. */
+int semopv_first_blocking(struct semop_t *ops, int n){
+    int i;
+    for (i = 0; i < n; i++){
+        if (ops[i].weight < 0 && &ops[i] != curr_proc->p_semv_held &&
+                sem_would_block(ops[i].semaddr, ops[i].weight))
+            return i;
+    }
+    return -1;
+}
+
+/* Return the process which got the resources it waited for on a semaphore to its ready
+ * queue. If it was a timed P the process leaves the sleep queue too. */
+void sem_wake(struct pcb_t *pcb){
+    // reset pcb field when freeing the process
+    pcb->s_req_weight = 0;
+    if (pcb->p_sleeping)
+        sleep_out(pcb);
+    ready_insert(pcb);
+}
+
+/* Take pcb, which is waiting on a semaphore which is not a device one, out of it without
+ * giving it the resources, e.g. because it's being killed or its P timed out. */
+void sem_cancel_wait(struct pcb_t *pcb){
+    // note: this particular implementation depends on our semaphore design
+    if((headBlocked(pcb->p_cursem->s_semAdd)) == pcb){
+        // we call sys_semaphoreop to manage sem value, since this pcb is HEAD: it gives back
+        // what pcb was waiting for, so pcb itself is woken up and then taken out again
+        // s_req_weight is <0, we must flip it before use it with sys_semaphoreop
+        sys_semaphoreop(pcb->p_cursem->s_semAdd, ((pcb->s_req_weight)*(-1)));
+        ready_out(pcb);
+    }
+    else {
+        // the value of the semaphore is unaffected, we can simply remove the process from it
+        outBlocked(pcb);
+        pcb->s_req_weight = 0;
+        if (pcb->p_sleeping)
+            sleep_out(pcb);
+    }
+}
+
+/* Block the calling process on the device (or pseudo clock) semaphore sem until the
+ * interrupt handler wakes it up with dev_wake().
+ * A process waiting on a device semaphore waits for its own event (e.g. the end of its
+ * request), not for a V: the processes on it are woken up by pcb, whatever their position
+ * in the queue, and the value of the semaphore is minus the number of processes on it. */
+void dev_wait(int *sem){
+    if (insertBlocked(sem, curr_proc))
+        // can't happen, there's a semaphore descriptor for each pcb
+        PANIC();
+    (*sem)--;
+    softblock_count++;
+}
+
+/* Wake up pcb, which is waiting on a device semaphore, passing it status in a1 */
+void dev_wake(struct pcb_t *pcb, unsigned int status){
+    dev_cancel_wait(pcb);
+    pcb->p_s.a1 = status;
+    ready_insert(pcb);
+}
+
+/* Take pcb, which is waiting on a device semaphore, out of it, e.g. because it's being
+ * killed: the event it waited for will find no one */
+void dev_cancel_wait(struct pcb_t *pcb){
+    int *sem = pcb->p_cursem->s_semAdd;
+    outBlocked(pcb);
+    (*sem)++;
+    softblock_count--;
+}
+
+/* Return TRUE if a P of the given weight on semaddr would put the process on wait */
+bool sem_would_block(int *semaddr, int weight){
+    // see sys_semaphoreop: a negative value means someone is already waiting
+    return *semaddr < 0 || *semaddr + weight < 0;
+}
+
 /* Generic function to prepare the handlers.
  * exc_const are constants specifying which handler we're preparing (syscall, tlb or program trap).  */
 int sys_define_handler(memaddr pc, memaddr sp, unsigned int flags, unsigned int exc_const, unsigned int check_exc){
-    if (!curr_proc->handler_defined[check_exc]) {
-        curr_proc->p_excpvec[exc_const].pc = pc; //handler
-        curr_proc->p_excpvec[exc_const].sp = sp; //stack pointer
-        curr_proc->p_excpvec[exc_const].cpsr = flags & 0xFF; //flags-cpsr
+    if (curr_proc->p_excp == NULL && allocExcp(curr_proc) == NULL) {
+        // no memory for the handlers: the process can't go on as it expects
+        sys_terminateprocess(0, curr_proc);
+        return SPECHDL_SCHEDULE_NEW;
+    }
+    if (!HANDLER_DEFINED(curr_proc, check_exc)) {
+        curr_proc->p_excp->p_excpvec[exc_const].pc = pc; //handler
+        curr_proc->p_excp->p_excpvec[exc_const].sp = sp; //stack pointer
+        curr_proc->p_excp->p_excpvec[exc_const].cpsr = flags & 0xFF; //flags-cpsr
         if (flags >> 31){
-            curr_proc->p_excpvec[exc_const].CP15_Control = CP15_ENABLE_VM(curr_proc->p_excpvec[exc_const].CP15_Control);
+            curr_proc->p_excp->p_excpvec[exc_const].CP15_Control = CP15_ENABLE_VM(curr_proc->p_excp->p_excpvec[exc_const].CP15_Control);
         }
         else {
-            curr_proc->p_excpvec[exc_const].CP15_Control = CP15_DISABLE_VM(curr_proc->p_excpvec[exc_const].CP15_Control);
+            curr_proc->p_excp->p_excpvec[exc_const].CP15_Control = CP15_DISABLE_VM(curr_proc->p_excp->p_excpvec[exc_const].CP15_Control);
         }
-        ENTRYHI_ASID_SET(curr_proc->p_excpvec[exc_const].CP15_EntryHi, ENTRYHI_ASID_GET(curr_proc->p_s.CP15_EntryHi));
-        curr_proc->handler_defined[check_exc] = TRUE;
+        ENTRYHI_ASID_SET(curr_proc->p_excp->p_excpvec[exc_const].CP15_EntryHi, ENTRYHI_ASID_GET(curr_proc->p_s.CP15_EntryHi));
+        curr_proc->p_excp->handler_defined[check_exc] = TRUE;
         return SPECHDL_GO_ON;
     }
     else {
@@ -481,73 +886,238 @@ int sys_define_handler(memaddr pc, memaddr sp, unsigned int flags, unsigned int
 }
 
 /* Manage devices operation.
- * One operation per device is allowed; if a second operation request comes in, the calling process
- * get notified that the device is busy (and it's up to that process to eventually try again).
- * An eventual higher level library may manage a queue on a device to avoid busy waiting (like it
- * is done in the print function in p2test).  */
+ * One operation per device is in progress at a time; if a second operation request comes in, it
+ * is queued in the kernel and sent when the previous ones are over. In both cases the calling
+ * process waits on the device semaphore, until the interrupt handler wakes up the owner of the
+ * request which is over (sync_pid). */
 int sys_iodevop(unsigned int command, int intlNo, unsigned int dnum){
-    // 0) declare anonymous registers variables
-    int* s_dev;
+    int sub;
+    struct dev_desc* desc = io_desc(intlNo, dnum, &sub);
+    if (desc == NULL)
+        return IO_DEV_NOT_INSTALLED;
+
+    // do the operation, or queue it if the device is busy
+    int result = io_submit(desc, sub, command, curr_proc, FALSE);
+    if (result != IO_DONE && result != IO_QUEUED)
+        return result;
+    if (result == IO_DONE)
+        desc->sync_pid[sub] = curr_proc->p_pid;
+
+    // wait on the device semaphore for the end of the request
+    dev_wait(desc->sem[sub]);
+    return IO_PROCESS_ON_WAIT;
+}
+
+/* Find the descriptor of device dnum on line intlNo and put in sub the subdevice dnum refers to
+ * (TERM_RECV for a terminal read, TERM_TRASM otherwise). Return NULL if there's no such device */
+struct dev_desc* io_desc(int intlNo, unsigned int dnum, int *sub){
+    // the top bit of dnum selects the terminal subdevice (1 == READ)
+    unsigned int which_dev = dnum & 0x7FFFFFFF;
+    if (intlNo < INT_LOWEST || intlNo >= INT_LOWEST + DEV_USED_INTS || which_dev >= DEV_PER_INT)
+        return NULL;
+    *sub = (intlNo == IL_TERMINAL) ? (int)(dnum >> 31) : TERM_TRASM;
+    // INT_LOWEST is the first real device
+    return &(dev_table[intlNo-INT_LOWEST][which_dev]);
+}
+
+/* Send command to the subdevice sub of desc if it's ready. Return IO_DEV_NOT_INSTALLED,
+ * IO_DEV_BUSY or IO_DONE if the command has been sent */
+int io_start(struct dev_desc *desc, int sub, unsigned int command){
     memaddr* comm_addr;
     // this is char* because in the terminal case we must consider only the least significant byte,
     // in other devs it doesnt matter since the state value always occupy less than one byte (as of
     // now)
     char* state_addr;
 
-    // 1) setting the variables depending on the actual device
-    // get device base address
-    devreg_t* device = (devreg_t*)DEV_REG_ADDR(intlNo, dnum & 0xFF); // args (interrupt line, device number)
-    if (intlNo == IL_TERMINAL)
-    {
-        // choose the right state and comm
-        if (dnum >> 31){ // READ
-            state_addr = (char*)&(device->term.recv_status);
-            comm_addr = &(device->term.recv_command);
-        }
-        else{ // WRITE
-            state_addr = (char*)&(device->term.transm_status);
-            comm_addr = &(device->term.transm_command);
-        }
-        // choose the right semaphore
-        s_dev = &(s_term_array[dnum & 0x7FFFFFFF][dnum >> 31]);
+    // choose the right state and comm
+    if (desc->line == IL_TERMINAL && sub == TERM_RECV){
+        state_addr = (char*)&(desc->reg->term.recv_status);
+        comm_addr = &(desc->reg->term.recv_command);
+    }
+    else if (desc->line == IL_TERMINAL){
+        state_addr = (char*)&(desc->reg->term.transm_status);
+        comm_addr = &(desc->reg->term.transm_command);
     }
     else{ // other devices interval line
-        // choose the right state and comm
-        state_addr = (char*)&(device->dtp.status);
-        comm_addr = &(device->dtp.command);
-        // choose the right semaphore. INT_LOWEST is the first real device
-        s_dev = &(s_dev_array[intlNo-INT_LOWEST][dnum]);
+        state_addr = (char*)&(desc->reg->dtp.status);
+        comm_addr = &(desc->reg->dtp.command);
     }
 
-    // 2) do the operation, if possible
+    // check if we can issue a command to the device (i.e. its ready)
+    if (*state_addr == DEV_NOT_INSTALLED){
+        // device not installed return error code
+        return IO_DEV_NOT_INSTALLED;
+    }
     if (*state_addr != DEV_S_READY){
-        // check if we can issue a command to the device (i.e. its ready)
-        if (*state_addr == DEV_NOT_INSTALLED){
-            // device not installed return error code
-            return IO_DEV_NOT_INSTALLED;
-        }
-        else{
-            // device busy (or operation not acked yet)
-            // return busy error code
-            return IO_DEV_BUSY;
-        }
-        // return immediately
+        // device busy (or operation not acked yet)
+        return IO_DEV_BUSY;
     }
-    else{
-        // the device is ready, send the command
-        *comm_addr = command;
+    // the device is ready, send the command
+    *comm_addr = command;
+    return IO_DONE;
+}
+
+/* Send command to the subdevice sub of desc on behalf of p if it's free, otherwise queue it
+ * (async is TRUE for an IODEVOPASYNC): the interrupt handler will send it when the requests
+ * before it are over, with the DATA0 it has now (but on terminals). A queued IODEVOP is recorded
+ * in p_ioreq. Return IO_DEV_NOT_INSTALLED, IO_DONE if the command has been sent, IO_QUEUED, or
+ * IO_DEV_BUSY if there's no memory to queue it or the disk is in use by the buffer cache */
+int io_submit(struct dev_desc *desc, int sub, unsigned int command, struct pcb_t *p, bool async){
+    if (desc->line == IL_DISK && bcache_busy(desc))
+        // the DATA0 of the request may already have been overwritten by the cache, or would be
+        return IO_DEV_BUSY;
+    int result = IO_DEV_BUSY;
+    if (clist_empty(desc->rq[sub]))
+        result = io_start(desc, sub, command);
+    if (result != IO_DEV_BUSY)
+        return result;
+    if (desc->line == IL_TERMINAL && sub == TERM_RECV && desc->rd->active)
+        // the receiver belongs to TERMREAD, the request would never be sent
+        return IO_DEV_BUSY;
+    struct io_req* req = kmem_alloc(&ioreq_cache);
+    if (req == NULL)
+        return IO_DEV_BUSY;
+    req->rq = &(desc->rq[sub]);
+    req->command = command;
+    if (desc->line != IL_TERMINAL)
+        // the register is set again when the request is sent, someone else may change it meanwhile
+        req->data0 = desc->reg->dtp.data0;
+    req->pid = p->p_pid;
+    req->async = async;
+    req->buf = NULL;
+    req->wr_buf = NULL;
+    clist_enqueue(req, req->rq, link);
+    if (!async)
+        p->p_ioreq = req;
+    return IO_QUEUED;
+}
+
+/* Take the IODEVOP queued by p out of its device request queue */
+void io_cancel(struct pcb_t *p){
+    clist_delete(p->p_ioreq, p->p_ioreq->rq, link);
+    kmem_free(&ioreq_cache, p->p_ioreq);
+    p->p_ioreq = NULL;
+}
+
+/* Send command to device dnum on line intlNo, as IODEVOP does, without waiting for it: the
+ * device status goes to the completion queue of the calling process, which is allocated
+ * the first time. Return IODEVOPASYNC_OK, IODEVOPASYNC_BUSY if the device is busy and there's no
+ * memory to queue the request, or
+ * IODEVOPASYNC_ERROR if there's no such device, no memory for the queue or the process has
+ * IO_CQ_SIZE requests not reaped yet */
+int sys_iodevop_async(unsigned int command, int intlNo, unsigned int dnum){
+    struct io_cq* cq = curr_proc->p_iocq;
+    if (cq == NULL && (cq = allocIocq(curr_proc)) == NULL)
+        return IODEVOPASYNC_ERROR;
+    if (cq->pending == IO_CQ_SIZE)
+        return IODEVOPASYNC_ERROR;
+    int sub;
+    struct dev_desc* desc = io_desc(intlNo, dnum, &sub);
+    if (desc == NULL)
+        return IODEVOPASYNC_ERROR;
+    switch (io_submit(desc, sub, command, curr_proc, TRUE)) {
+        case IO_DONE:
+            // the interrupt handler will post the completion to the process
+            desc->async_pid[sub] = curr_proc->p_pid;
+            cq->pending++;
+            return IODEVOPASYNC_OK;
+        case IO_QUEUED:
+            cq->pending++;
+            return IODEVOPASYNC_OK;
+        case IO_DEV_BUSY:
+            return IODEVOPASYNC_BUSY;
+        default:
+            return IODEVOPASYNC_ERROR;
     }
+}
 
-    // 3) lock on the device semaphore
-    int result = sys_semaphoreop(s_dev, -1);
-    if (result == SEM_PROCESS_ON_WAIT){
-        softblock_count++;
-        return IO_PROCESS_ON_WAIT;
+/* Move the oldest completion of cq, if any, into out. Return 1 if there was one, 0 otherwise */
+int io_reap(struct io_cq *cq, struct io_completion *out){
+    if (cq->count == 0)
+        return 0;
+    *out = cq->ring[cq->head];
+    cq->head = (cq->head + 1) % IO_CQ_SIZE;
+    cq->count--;
+    cq->pending--;
+    return 1;
+}
+
+/* Start a TERMWRITE of the len (> 0) characters of buf on terminal dnum and block the calling
+ * process until the interrupt handler has transmitted them all, or a transmission error
+ * occurred. If the transmitter is busy the write is queued behind the requests before it,
+ * as an IODEVOP. Return IO_DEV_NOT_INSTALLED or IO_DEV_BUSY as sys_iodevop does, or
+ * IO_PROCESS_ON_WAIT. */
+int sys_termwrite(unsigned int dnum, char *buf, unsigned int len){
+    if (dnum >= DEV_PER_INT)
+        return IO_DEV_NOT_INSTALLED;
+    struct dev_desc* desc = &(dev_table[IL_TERMINAL-INT_LOWEST][dnum]);
+    // the first character is sent here or by io_next(), terminal_handler() sends the others
+    unsigned int command = DEV_TTRS_C_TRSMCHAR | ((unsigned char) buf[0] << TERM_CHAR_SHIFT);
+    int result = io_submit(desc, TERM_TRASM, command, curr_proc, FALSE);
+    if (result == IO_DONE)
+        term_write_start(desc, buf, len, curr_proc->p_pid);
+    else if (result == IO_QUEUED){
+        curr_proc->p_ioreq->wr_buf = buf;
+        curr_proc->p_ioreq->wr_len = len;
     }
-    else{
-        // error, the process should always lock on the device semaphore
-        PANIC();
+    else
+        return result;
+
+    // wait on the terminal semaphore, as sys_iodevop does
+    dev_wait(desc->sem[TERM_TRASM]);
+    return IO_PROCESS_ON_WAIT;
+}
+
+/* Record on the terminal of desc the TERMWRITE of the len characters of buf by pid, whose
+ * first character has just been sent */
+void term_write_start(struct dev_desc *desc, char *buf, unsigned int len, pid_t pid){
+    desc->wr.buf = buf + 1;
+    desc->wr.left = len - 1;
+    desc->wr.done = 0;
+    desc->wr.pid = pid;
+}
+
+/* Read up to len (> 0) characters from terminal dnum into buf, stopping after a newline.
+ * The first call puts the terminal receiver in buffered mode. The characters already
+ * received are taken at once; if they are not enough, the calling process blocks and the
+ * interrupt handler copies the next ones into buf. done is the number of characters
+ * copied so far. Return IO_DEV_NOT_INSTALLED or IO_DEV_BUSY as sys_iodevop does,
+ * IO_DONE if the read is complete, or IO_PROCESS_ON_WAIT. */
+int sys_termread(unsigned int dnum, char *buf, unsigned int len, unsigned int *done){
+    if (dnum >= DEV_PER_INT)
+        return IO_DEV_NOT_INSTALLED;
+    struct dev_desc* desc = &(dev_table[IL_TERMINAL-INT_LOWEST][dnum]);
+    struct term_read* rd = desc->rd;
+    termreg_t* term = &(desc->reg->term);
+    int* s_dev = desc->sem[TERM_RECV];
+    if (!rd->active){
+        if ((char)term->recv_status != DEV_S_READY){
+            if ((char)term->recv_status == DEV_NOT_INSTALLED)
+                return IO_DEV_NOT_INSTALLED;
+            return IO_DEV_BUSY;
+        }
+        // from now on the receiver is always busy, terminal_handler() stores the characters
+        rd->active = TRUE;
+        term->recv_command = DEV_TRCV_C_RECVCHAR;
     }
+    *done = 0;
+    if (headBlocked(s_dev) == NULL){
+        // take the characters already received (if someone is waiting the ring is empty)
+        while (rd->count > 0 && *done < len){
+            char c = rd->ring[rd->head];
+            rd->head = (rd->head + 1) % TERM_RING_SIZE;
+            rd->count--;
+            buf[(*done)++] = c;
+            if (c == '\n')
+                return IO_DONE;
+        }
+        if (*done == len)
+            return IO_DONE;
+    }
+
+    // wait on the terminal semaphore, the readers are served in FIFO order
+    dev_wait(s_dev);
+    return IO_PROCESS_ON_WAIT;
 }
 
 /* Save into given location user and global time */
@@ -556,27 +1126,149 @@ void sys_cputime(cputime_t *global, cputime_t *user){
     *user = curr_proc->usr_time;
 }
 
+/* Set the priority of the calling process. Return the old priority, or
+ * SETPRIORITY_ERROR if the requested one is out of range.
+ * With MLFQ this is the highest level the process can reach, and it starts again from there. */
+int sys_setpriority(int prio){
+    if (prio < SCHED_PRIO_MIN || prio > SCHED_PRIO_MAX)
+        return SETPRIORITY_ERROR;
+    int old = curr_proc->p_base_prio;
+    curr_proc->p_base_prio = prio;
+    curr_proc->p_prio = prio;
+    curr_proc->p_level_start = curr_proc->usr_time + curr_proc->sys_time;
+    return old;
+}
+
+/* Set the time slice of the calling process, in microseconds. Return the old one, or
+ * SETTIMESLICE_ERROR if the requested one is out of [SCHED_QUANTUM_MIN, SCHED_QUANTUM_MAX]. */
+int sys_settimeslice(cputime_t quantum){
+    if (quantum < SCHED_QUANTUM_MIN || quantum > SCHED_QUANTUM_MAX)
+        return SETTIMESLICE_ERROR;
+    int old = curr_proc->p_quantum;
+    curr_proc->p_quantum = quantum;
+    return old;
+}
+
+/* Set the stride scheduling tickets of the calling process. Return the old ones, or
+ * SETTICKETS_ERROR if the requested ones are out of [1, SCHED_TICKETS_MAX]. */
+int sys_settickets(unsigned int tickets){
+    if (tickets < 1 || tickets > SCHED_TICKETS_MAX)
+        return SETTICKETS_ERROR;
+    int old = curr_proc->p_tickets;
+    curr_proc->p_tickets = tickets;
+    return old;
+}
+
+/* Make the calling process a real time process which runs up to budget microseconds every
+ * period microseconds, or a best effort one again if period is 0. Return 0, or
+ * SETREALTIME_ERROR if the parameters are out of range or the overall real time
+ * utilization would exceed SCHED_RT_MAX_UTIL per mille. */
+int sys_setrealtime(cputime_t period, cputime_t budget){
+    if (period == 0){
+        rt_leave(curr_proc);
+        return 0;
+    }
+    if (period < SCHED_RT_PERIOD_MIN || period > SCHED_RT_PERIOD_MAX ||
+            budget == 0 || budget > period)
+        return SETREALTIME_ERROR;
+    if (!rt_enter(curr_proc, period, budget))
+        return SETREALTIME_ERROR;
+    return 0;
+}
+
 /* Return the process pid */
 pid_t getPID(){
     return curr_proc->p_pid;
 }
 
-/* We chose to allocate the lowest free pid from a pool of MAXPROC pids. */
-pid_t generatePID(){
-    int i;
-    for(i=0; i<MAXPROC; i++){
-        //scan for a free pid
-        if (free_pidmap[i] == TRUE){
-            free_pidmap[i] = FALSE;
-            break;
-        }
-    }
-    if (i == MAXPROC){
+/* Allocate a pid for pcb: take the least recently freed slot of the pid table and tag its
+ * index with the generation of the slot. Return 0 if the table is full and can't grow. */
+pid_t generatePID(struct pcb_t *pcb){
+    if (pid_free_head < 0 && !pid_table_grow()){
         //all the pids were taken. 
-        PANIC();
+        return 0;
+    }
+    int i = pid_free_head;
+    struct pid_entry *e = PID_ENTRY(i);
+    pid_free_head = e->next_free;
+    if (pid_free_head < 0)
+        pid_free_tail = -1;
+    e->pcb = pcb;
+    return MAKE_PID(e->gen, i);
+}
+
+/* Give back the slot of pid to the pid table, moving it to its next generation */
+void releasePID(pid_t pid){
+    int i = PID_INDEX(pid);
+    struct pid_entry *e = PID_ENTRY(i);
+    e->pcb = NULL;
+    e->gen = (e->gen == PID_GEN_MAX) ? 1 : e->gen + 1;
+    // append the slot to the free FIFO
+    e->next_free = -1;
+    if (pid_free_tail < 0)
+        pid_free_head = i;
+    else
+        PID_ENTRY(pid_free_tail)->next_free = i;
+    pid_free_tail = i;
+}
+
+/* Add a chunk of free slots, at their first generation, to the pid table.
+ * Return FALSE if the table reached its maximum size or there's no memory left. */
+bool pid_table_grow(){
+    if (pid_slots / PID_CHUNK_SIZE == PID_DIR_SIZE)
+        return FALSE;
+    struct pid_entry *chunk = kmem_page_alloc();
+    if (chunk == NULL)
+        return FALSE;
+    pid_dir[pid_slots / PID_CHUNK_SIZE] = chunk;
+    int i;
+    for (i = 0; i < PID_CHUNK_SIZE; i++){
+        chunk[i].pcb = NULL;
+        chunk[i].gen = 1;
+        chunk[i].next_free = (i + 1 < PID_CHUNK_SIZE) ? pid_slots + i + 1 : -1;
     }
+    // the free FIFO is empty when the table grows
+    pid_free_head = pid_slots;
+    pid_free_tail = pid_slots + PID_CHUNK_SIZE - 1;
+    pid_slots += PID_CHUNK_SIZE;
+    return TRUE;
+}
+
+/* Return the process with the given pid, or NULL if there's none (e.g. the pid is stale) */
+struct pcb_t* pid_lookup(pid_t pid){
+    int i = PID_INDEX(pid);
+    if (i >= pid_slots)
+        return NULL;
+    struct pid_entry *e = PID_ENTRY(i);
+    if (e->pcb == NULL || e->gen != PID_GEN(pid))
+        return NULL;
+    return e->pcb;
+}
 
-    return i;
+/* Fill the user buffer stats with the usage of the given kernel cache (KMEM_CACHE_PCB,
+ * KMEM_CACHE_SEMD, KMEM_CACHE_EXCP, KMEM_CACHE_IOCQ or KMEM_CACHE_IOREQ). Return the number of free pages left, or KMEMSTAT_ERROR if there's no
+ * such cache. */
+int sys_kmemstat(int which, struct kmem_stats *stats){
+    switch (which) {
+        case KMEM_CACHE_PCB:
+            kmem_cache_stats(&pcb_cache, stats);
+            break;
+        case KMEM_CACHE_SEMD:
+            kmem_cache_stats(&semd_cache, stats);
+            break;
+        case KMEM_CACHE_EXCP:
+            kmem_cache_stats(&excp_cache, stats);
+            break;
+        case KMEM_CACHE_IOCQ:
+            kmem_cache_stats(&iocq_cache, stats);
+            break;
+        case KMEM_CACHE_IOREQ:
+            kmem_cache_stats(&ioreq_cache, stats);
+            break;
+        default:
+            return KMEMSTAT_ERROR;
+    }
+    return kmem_pages_free();
 }
 
 /* Update the user/system time fields in the pcb, using a given timestamp
@@ -595,12 +1287,12 @@ void update_sys_time(unsigned int start_timestamp, struct pcb_t* pcb){
 /* The system TLB handler */
 void TLB_Handler() {
     unsigned int tlb_enter_timestamp = getTODLO();
-    if (curr_proc->handler_defined[CHECK_TLB_HDL]){
+    if (HANDLER_DEFINED(curr_proc, CHECK_TLB_HDL)){
         // handle tlb
-        curr_proc->p_excpvec[EXCP_TLB_OLD] = *((state_t*) TLB_OLDAREA);
-        curr_proc->p_excpvec[EXCP_TLB_NEW].a1 = curr_proc->p_excpvec[EXCP_TLB_OLD].CP15_Cause;
+        curr_proc->p_excp->p_excpvec[EXCP_TLB_OLD] = *((state_t*) TLB_OLDAREA);
+        curr_proc->p_excp->p_excpvec[EXCP_TLB_NEW].a1 = curr_proc->p_excp->p_excpvec[EXCP_TLB_OLD].CP15_Cause;
         update_sys_time(tlb_enter_timestamp, curr_proc);
-        LDST(&(curr_proc->p_excpvec[EXCP_TLB_NEW]));
+        LDST(&(curr_proc->p_excp->p_excpvec[EXCP_TLB_NEW]));
     }
     else {
         //suicide
@@ -612,12 +1304,12 @@ void TLB_Handler() {
 /* The system PGMT handler */
 void PGMT_Handler() {
     unsigned int pgmt_enter_timestamp = getTODLO();
-    if (curr_proc->handler_defined[CHECK_PGMT_HDL]){
+    if (HANDLER_DEFINED(curr_proc, CHECK_PGMT_HDL)){
         // handle pgmt
-        curr_proc->p_excpvec[EXCP_PGMT_OLD] = *((state_t*) PGMTRAP_OLDAREA);
-        curr_proc->p_excpvec[EXCP_PGMT_NEW].a1 = curr_proc->p_excpvec[EXCP_PGMT_OLD].CP15_Cause;
+        curr_proc->p_excp->p_excpvec[EXCP_PGMT_OLD] = *((state_t*) PGMTRAP_OLDAREA);
+        curr_proc->p_excp->p_excpvec[EXCP_PGMT_NEW].a1 = curr_proc->p_excp->p_excpvec[EXCP_PGMT_OLD].CP15_Cause;
         update_sys_time(pgmt_enter_timestamp, curr_proc);
-        LDST(&(curr_proc->p_excpvec[EXCP_PGMT_NEW]));
+        LDST(&(curr_proc->p_excp->p_excpvec[EXCP_PGMT_NEW]));
     }
     else {
         //suicide
@@ -30,10 +30,10 @@
  * ciated with the semaphore whose physical address is semAdd and set the
  * semaphore address of p to semAdd. If the semaphore is currently not ac-
  * tive (i.e. there is no descriptor for it in the ASL), allocate a new descriptor
- * from the semdFree list, insert it in the ASL (at the appropriate position),
+ * from the semd cache, insert it in the ASL (in its hash bucket),
  * initialize all of the fields (i.e. set s_semAdd to semAdd, and s_procq), and
  * proceed as above. If a new semaphore descriptor needs to be allocated
- * and the semdFree list is empty, return TRUE. In all other cases return
+ * and there is no memory left for it, return TRUE. In all other cases return
  * FALSE. */
 
 int insertBlocked(int *semAdd, struct pcb_t *p);
@@ -42,16 +42,25 @@ int insertBlocked(int *semAdd, struct pcb_t *p);
  * NULL; otherwise, remove the first (i.e. head) ProcBlk from the process
  * queue of the found semaphore descriptor and return a pointer to it. If the
  * process queue for this semaphore becomes empty remove the semaphore
- * descriptor from the ASL and return it to the semdFree list */
+ * descriptor from the ASL and return it to the semd cache */
 
 struct pcb_t *removeBlocked(int *semAdd);
 
+/* Search the ASL for a descriptor of this semaphore. If none is found, return
+ * 0; otherwise, move its whole process queue, in order, to the tail of the
+ * process queue q, remove the semaphore descriptor from the ASL and return
+ * it to the semd cache. The queue is moved in constant time, only the
+ * semaphore address and the queue of the moved ProcBlks are reset one by
+ * one. Return the number of ProcBlks moved */
+
+int removeAllBlocked(int *semAdd, struct dlist *q);
+
 /* Remove the ProcBlk pointed to by p from the process queue associated
  * with p's semaphore on the ASL. If ProcBlk pointed to by p does not
  * appear in the process queue associated with p's semaphore, which is an
  * error condition, return NULL; otherwise, return p. If the
  * process queue for this semaphore becomes empty we decided to remove the 
- * semaphore descriptor from the ASL and return it to the semdFree list */
+ * semaphore descriptor from the ASL and return it to the semd cache */
 
 
 struct pcb_t *outBlocked(struct pcb_t *p);
@@ -62,7 +71,7 @@ struct pcb_t *outBlocked(struct pcb_t *p);
 
 struct pcb_t *headBlocked(int *semAdd);
 
-/* Initialize the semdFree list to contain all the elements of the array */
+/* Initialize the semaphore descriptor cache and the ASL */
 
 void initASL(void);
 
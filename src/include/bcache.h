@@ -0,0 +1,73 @@
+/* Buffer cache of the disk blocks
+ *
+ * A didactic simulation of an arm OS running on the uarm emulator.
+ * Copyright (C) 2016 Carlo De Pieri, Alessio Koci, Gianmaria Pedrini,
+ * Alessio Trivisonno
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BCACHE
+#define _BCACHE
+#include <types.h>
+
+/* The cache keeps up to DISK_CACHE_BUFS blocks of the disks on IL_DISK, each in a kmem page
+ * taken the first time the buffer is used. A block is addressed by its linear number:
+ * (cylinder * heads + head) * sectors + sector, with the geometry in the disk DATA1 register.
+ * Reads of cached blocks and writes don't touch the disk: dirty blocks are written back when
+ * their buffer is reused for another block, or by DISKSYNC. The buffer reused is the least
+ * recently used one which is not busy, preferring the clean ones.
+ * Disk operations of the cache go through the device request queue like IODEVOP, and count
+ * as soft blocked processes until they end. A process which has to wait for one blocks on the
+ * semaphore of the buffer, and issues the SYSCALL again once woken up. DATA0 holds the address of
+ * a cache page during a transfer, so IODEVOP on a disk returns DEV_BUSY while the cache has
+ * operations in progress or queued on it. */
+
+/* DISKREAD: copy block of disk into the DISK_BLOCK_SIZE bytes at buf.
+ * Return DISK_OK, DISK_ERROR if there's no such block or the disk read failed, or DISK_WAIT
+ * if the calling process has been put on wait */
+int bcache_read(unsigned int disk, unsigned int block, void *buf);
+
+/* DISKWRITE: copy the DISK_BLOCK_SIZE bytes at buf into block of disk, which is written back
+ * later. Return DISK_OK, DISK_ERROR if there's no such block or no memory for the cache,
+ * or DISK_WAIT */
+int bcache_write(unsigned int disk, unsigned int block, void *buf);
+
+/* DISKSYNC: write back the dirty blocks of disk, one at a time. Return DISK_OK once they are
+ * all on the disk, DISK_ERROR if there's no such disk or some write back failed since the
+ * last DISKSYNC, or DISK_WAIT */
+int bcache_sync(unsigned int disk);
+
+/* TRUE if the cache is using the disk of desc: it has an operation in progress or queued on it.
+ * DATA0 belongs to the cache then, so IODEVOP can't use the disk */
+bool bcache_busy(struct dev_desc *desc);
+
+/* Called by the interrupt handler when the command of the buffer cache operation in progress
+ * on the disk of desc is over, with the disk already acknowledged, or when the disk didn't take
+ * it (status is not DEV_S_READY then). Return TRUE if the next command of the operation has
+ * been sent, FALSE if the operation is over: the buffer is released and its waiters woken up */
+bool bcache_io_done(struct dev_desc *desc, unsigned int status);
+
+// buffer states
+#define BUF_EMPTY 0
+#define BUF_VALID 1
+#define BUF_READ 2
+#define BUF_WRITE 3
+#define BUF_ERROR 4
+
+// DISKREAD, DISKWRITE and DISKSYNC results
+#define DISK_OK 0
+#define DISK_ERROR -1
+#define DISK_WAIT 1
+
+#endif
@@ -35,13 +35,75 @@
 	#define FALSE 0
 #endif
 
-/* Maximum number of overall (eg, system, daemons, user) concurrent processes */
+/* Number of processes the phase 1 test allocates. There's no fixed maximum anymore:
+ * pcbs and semaphore descriptors are allocated from the free RAM as needed (see kmem.h) */
 #define MAXPROC 20
 
+/* Kernel memory allocator constants */
+#define KMEM_PAGE_SIZE 4096          /* size of a slab */
+#define KMEM_STACK_RESERVE 0x10000   /* top of RAM left to the kernel and process stacks, 64KB */
+
+/* Number of buckets of the ASL hash table, a power of 2 */
+#define ASL_HASH_BITS 5
+#define ASL_HASH_SIZE (1 << ASL_HASH_BITS)
+
+/* A pid is made of the index of the process in the pid table (low bits) and the generation
+ * of that slot (high bits), which changes every time the slot is freed: a stale pid doesn't
+ * match the process which reused its slot. Generations start at 1, so no pid is 0. */
+#define PID_INDEX_BITS 16
+#define PID_INDEX(pid) ((pid) & ((1 << PID_INDEX_BITS) - 1))
+#define PID_GEN(pid) ((pid) >> PID_INDEX_BITS)
+#define MAKE_PID(gen, index) (((gen) << PID_INDEX_BITS) | (index))
+#define PID_GEN_MAX ((1 << (32 - PID_INDEX_BITS)) - 1)
+/* The pid table grows by chunks of PID_CHUNK_SIZE slots (a chunk must fit in a page) */
+#define PID_CHUNK_SIZE 256
+#define PID_DIR_SIZE ((1 << PID_INDEX_BITS) / PID_CHUNK_SIZE)
+
 /* Scheduling constants */
-#define SCHED_TIME_SLICE 5000     /* in microseconds, aka 5 milliseconds */
+#define SCHED_TIME_SLICE 5000     /* default time slice, in microseconds, aka 5 milliseconds */
+#define SCHED_QUANTUM_MIN 500     /* shortest time slice a process can ask for */
+#define SCHED_QUANTUM_MAX 500000  /* longest time slice a process can ask for */
 #define SCHED_PSEUDO_CLOCK 100000 /* pseudo-clock tick "slice" length */
-#define SCHED_BOGUS_SLICE 500000  /* just to make sure */
+#define SCHED_BOGUS_SLICE 500000  /* timer interval when there are no timer events, just to make sure */
+
+/* Priority scheduling constants: every level has its own ready queue and a bit
+ * in the ready bitmap. Higher values mean higher priority. */
+#define SCHED_PRIO_LEVELS 8
+#define SCHED_PRIO_MIN 0
+#define SCHED_PRIO_MAX (SCHED_PRIO_LEVELS-1)
+#define SCHED_PRIO_DEFAULT 3
+
+/* Scheduling policies, the one in use is chosen at build time (see the Makefile):
+ *  - SCHED_POLICY_PRIO: strict priority, a process always runs at the priority it asked for
+ *  - SCHED_POLICY_MLFQ: multilevel feedback queue, the priority a process asked for is the
+ *      highest level it can reach. It's demoted when it uses up its time allotment and it's
+ *      boosted when it blocks on a device or on the pseudo clock.
+ *  - SCHED_POLICY_STRIDE: stride scheduling among the processes with the same priority, each
+ *      one gets a share of the CPU proportional to its tickets. */
+#define SCHED_POLICY_PRIO 0
+#define SCHED_POLICY_MLFQ 1
+#define SCHED_POLICY_STRIDE 2
+#ifndef SCHED_POLICY
+    #define SCHED_POLICY SCHED_POLICY_PRIO
+#endif
+
+/* MLFQ constants (the time allotment of a process at each level is its time slice) */
+#define SCHED_MLFQ_BOOST_PERIOD 1000000 /* time between two anti starvation boosts, aka 1 second */
+
+/* Stride scheduling constants */
+#define SCHED_STRIDE1 (1 << 16)     /* the stride of a process is SCHED_STRIDE1 / its tickets */
+#define SCHED_STRIDE_UNIT 100       /* cpu time is charged to the pass in units of 100 microseconds */
+#define SCHED_TICKETS_DEFAULT 100
+#define SCHED_TICKETS_MAX 1000
+
+/* Real time class constants. Real time processes are scheduled earliest deadline first,
+ * ahead of every other process; each job can use up to its budget in its period. */
+#define SCHED_RT_PERIOD_MIN 1000     /* 1 millisecond */
+#define SCHED_RT_PERIOD_MAX 4000000  /* 4 seconds */
+#define SCHED_RT_MAX_UTIL 900        /* max overall budget/period of real time processes, per mille */
+
+/* Longest SLEEP, so that wake up times can be compared as signed differences */
+#define SCHED_SLEEP_MAX 0x7FFFFFFF
 
 /* nucleus (phase2)-handled SYSCALL values */
 #define CREATEPROCESS 1
@@ -59,6 +121,51 @@
 #define SYSCALL_MIN 1
 #define SYSCALL_MAX 11
 
+/* nucleus-handled SYSCALL values not in the phase 2 specification.
+ * They start at 32 to leave room to the values passed up to the process' SYS handler
+ * (p2test uses 13 and 14) */
+#define SETPRIORITY 32
+#define SETTIMESLICE 33
+#define SETTICKETS 34
+#define SETREALTIME 35
+#define SLEEP 36
+#define SEMOPV 37
+#define KMEMSTAT 38
+#define TERMWRITE 39
+#define TERMREAD 40
+#define IODEVOPASYNC 41
+#define IOREAP 42
+#define DISKREAD 43
+#define DISKWRITE 44
+#define DISKSYNC 45
+
+#define SYSCALL_EXT_MIN 32
+#define SYSCALL_EXT_MAX 45
+
+/* KMEMSTAT caches */
+#define KMEM_CACHE_PCB 0
+#define KMEM_CACHE_SEMD 1
+#define KMEM_CACHE_EXCP 2
+#define KMEM_CACHE_IOCQ 3
+#define KMEM_CACHE_IOREQ 4
+
+/* asynchronous I/O requests a process can have in progress or not reaped yet */
+#define IO_CQ_SIZE 8
+
+/* disk blocks (uARM disk sectors are 4KB) and blocks in the buffer cache, one kmem page each */
+#define DISK_BLOCK_SIZE 4096
+#define DISK_CACHE_BUFS 16
+
+/* SEMOP a4 values besides a timeout in microseconds */
+#define SEMOP_FOREVER 0
+#define SEMOP_TRY 0xFFFFFFFF
+
+/* Max number of operations of a SEMOPV vector */
+#define SEMOPV_MAX 8
+
+#define IS_NUCLEUS_SYSCALL(n) (((n) >= SYSCALL_MIN && (n) <= SYSCALL_MAX) || \
+        ((n) >= SYSCALL_EXT_MIN && (n) <= SYSCALL_EXT_MAX))
+
 /* pcb exception states vector constants */
 #define EXCP_SYS_OLD 0
 #define EXCP_TLB_OLD 1
@@ -80,5 +187,11 @@
 #define TERM_RECV 1
 #define TERM_TRASM 0
 #define TERM_SUBDEV 2
+// the character is the second byte of terminal commands and statuses
+#define TERM_CHAR_SHIFT 8
+// size of the input ring buffer of a terminal read with TERMREAD (a power of 2)
+#define TERM_RING_SIZE 128
+// CP15_Cause has the bitmap of the pending interrupt lines in its top byte
+#define CAUSE_IP_SHIFT 24
 
 #endif
@@ -0,0 +1,193 @@
+/* Doubly linked circular lists macro
+ *
+ * A didactic simulation of an arm OS running on the uarm emulator.
+ * Copyright (C) 2016 Carlo De Pieri, Alessio Koci, Gianmaria Pedrini,
+ * Alessio Trivisonno
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DLIST_H
+#define _DLIST_H
+
+#include <types.h>
+#include <clist.h> /* container_of and offsetof */
+
+/* Same layout as clist: the list is identified by a tail pointer and the
+ * tail element links forward to the head. Every element also links back
+ * to its predecessor, so an element can be unlinked in O(1) without
+ * scanning the list for it. The prev field of the tail pointer is unused. */
+
+/* constant used to initialize an empty list */
+#define DLIST_INIT {NULL, NULL}
+#define DHEAD(dlistp) (dlistp)->next->next
+#define DTAIL(dlistp) (dlistp)->next
+
+/* dlist_empty returns true in the circular list is empty, false otherwise */
+/* dlistx is a struct dlist */
+#define dlist_empty(dlistx) (((dlistx).next)==NULL)
+
+/* link the node n of an empty list as its only element */
+#define _dlist_init_one(n, dlistp)                                      \
+        (n)->next = (n);                                                \
+        (n)->prev = (n);                                                \
+        DTAIL(dlistp) = (n)
+
+/* link the node n between the nodes before and after */
+#define _dlist_link(n, before, after)                                   \
+        (n)->prev = (before);                                           \
+        (n)->next = (after);                                            \
+        (after)->prev = (n);                                            \
+        (before)->next = (n)
+
+/* add the structure pointed to by elem as the last element of a circular list */
+/* dlistp is the address of the tail pointer (struct dlist *) */
+/* member is the field of *elem used to link this list */
+#define dlist_enqueue(elem, dlistp, member) ({                          \
+                        struct dlist *__n = &((elem)->member);          \
+                        if (DTAIL(dlistp)) {                            \
+                                _dlist_link(__n, DTAIL(dlistp), DHEAD(dlistp)); \
+                                DTAIL(dlistp) = __n;                    \
+                        }                                               \
+                        else {                                          \
+                                _dlist_init_one(__n, dlistp);           \
+                        }                                               \
+                })
+
+/* add the structure pointed to by elem as the first element of a circular list */
+/* dlistp is the address of the tail pointer (struct dlist *) */
+/* member is the field of *elem used to link this list */
+#define dlist_push(elem, dlistp, member) ({                             \
+                        struct dlist *__n = &((elem)->member);          \
+                        if (DTAIL(dlistp)) {                            \
+                                _dlist_link(__n, DTAIL(dlistp), DHEAD(dlistp)); \
+                        }                                               \
+                        else {                                          \
+                                _dlist_init_one(__n, dlistp);           \
+                        }                                               \
+                })
+
+/* return the pointer of the first element of the circular queue.
+   elem is also an argument to retrieve the type of the element */
+/* member is the field of *elem used to link this list */
+#define dlist_head(elem, dlistx, member) ({                             \
+                        typeof(elem) __hptr;                            \
+                        if ((dlistx).next) __hptr = container_of( ((dlistx).next)->next, typeof(*elem), member); \
+                        else __hptr = NULL;                             \
+                        __hptr;                                         \
+                })
+
+/* return the pointer of the last element of the circular queue.
+   elem is also an argument to retrieve the type of the element */
+/* member is the field of *elem used to link this list */
+#define dlist_tail(elem, dlistx, member) ({                             \
+                        typeof(elem) __tptr;                            \
+                        if ((dlistx).next) __tptr = container_of((dlistx).next, typeof(*elem), member); \
+                        else __tptr = NULL;                             \
+                        __tptr;                                         \
+                })
+
+/* return the element following elem, or NULL if elem is the last one */
+/* dlistp is the address of the tail pointer (struct dlist *) */
+/* member is the field of *elem used to link this list */
+#define dlist_next(elem, dlistp, member) ({                             \
+                        typeof(elem) __nptr;                            \
+                        if (&((elem)->member) == DTAIL(dlistp)) __nptr = NULL; \
+                        else __nptr = container_of((elem)->member.next, typeof(*elem), member); \
+                        __nptr;                                         \
+                })
+
+/* delete from a circular list the element whose pointer is elem, in O(1).
+ * elem must be linked in the list pointed to by dlistp; its links are
+ * cleared, so an unlinked element has member.next == NULL */
+/* dlistp is the address of the tail pointer (struct dlist *) */
+/* member is the field of *elem used to link this list */
+#define dlist_delete(elem, dlistp, member) ({                           \
+                        struct dlist *__n = &((elem)->member);          \
+                        if (__n->next == __n)                           \
+                                /* one element list */                  \
+                                DTAIL(dlistp) = NULL;                   \
+                        else {                                          \
+                                __n->prev->next = __n->next;            \
+                                __n->next->prev = __n->prev;            \
+                                if (DTAIL(dlistp) == __n) DTAIL(dlistp) = __n->prev; \
+                        }                                               \
+                        __n->next = NULL;                               \
+                        __n->prev = NULL;                               \
+                })
+
+/* dlist_pop and dlist_dequeue are synonyms */
+/* delete the first element of the list (this macro does not return any value) */
+/* dlistp is the address of the tail pointer (struct dlist *) */
+#define dlist_pop(dlistp) dlist_dequeue(dlistp)
+#define dlist_dequeue(dlistp)                                           \
+        if (!dlist_empty(*dlistp)) {                                    \
+                struct dlist *__h = DHEAD(dlistp);                      \
+                if (__h == DTAIL(dlistp)) DTAIL(dlistp) = NULL;         \
+                else {                                                  \
+                        DHEAD(dlistp) = __h->next;                      \
+                        __h->next->prev = DTAIL(dlistp);                \
+                }                                                       \
+                __h->next = NULL;                                       \
+                __h->prev = NULL;                                       \
+        }
+
+/* move all the elements of the list srcp to the tail of the list dstp,
+   keeping their order, and leave srcp empty. It takes constant time */
+/* srcp and dstp are the addresses of the tail pointers (struct dlist *) */
+#define dlist_splice(srcp, dstp) ({                                     \
+                        if (!dlist_empty(*srcp)) {                      \
+                                if (!dlist_empty(*dstp)) {              \
+                                        struct dlist *__sh = DHEAD(srcp); \
+                                        struct dlist *__dh = DHEAD(dstp); \
+                                        DTAIL(dstp)->next = __sh;       \
+                                        __sh->prev = DTAIL(dstp);       \
+                                        DTAIL(srcp)->next = __dh;       \
+                                        __dh->prev = DTAIL(srcp);       \
+                                }                                       \
+                                DTAIL(dstp) = DTAIL(srcp);              \
+                                DTAIL(srcp) = NULL;                     \
+                        }                                               \
+                })
+
+/* this macro has been designed to be used as a for instruction,
+   the instruction (or block) following dlist_foreach will be repeated for each element
+   of the circular list. scan will be assigned to each element and is NULL
+   after the loop if all the elements have been scanned */
+/* dlistp is the address of the tail pointer (struct dlist *) */
+/* member is the field of *elem used to link this list */
+/* tmp is a typeof(scan) temporary variable holding the next element, so
+   scan can be deleted with dlist_delete inside the loop */
+#define dlist_foreach(scan, dlistp, member, tmp)                        \
+        for (scan = dlist_head(scan, *dlistp, member),                  \
+                     tmp = (scan ? dlist_next(scan, dlistp, member) : NULL); \
+             scan != NULL;                                              \
+             scan = tmp, tmp = (scan ? dlist_next(scan, dlistp, member) : NULL))
+
+/* this macro should be used after the end of a dlist_foreach cycle
+   using the same args. it returns false if the cycle terminated by a break,
+   true if it scanned all the elements */
+#define dlist_foreach_all(scan, dlistp, member, tmp) ({ \
+                        (scan == NULL);                 \
+                })
+
+/* add the structure pointed to by elem before the element scan, which must
+   be linked in the list (e.g. inside a dlist_foreach loop). If scan is
+   the head, elem becomes the new head */
+#define dlist_foreach_add(elem, scan, dlistp, member, tmp) ({           \
+                        struct dlist *__at = &((scan)->member);         \
+                        struct dlist *__before = __at->prev;            \
+                        _dlist_link(&((elem)->member), __before, __at); \
+                })
+
+#endif
@@ -36,12 +36,18 @@ void PGMT_Handler();
  * Helper functions *
  ********************/
 
-/* Create a new pcb, insert it into the ready_queue and return its pid */
+/* Create a new pcb, insert it into the ready queues and return its pid.
+ * The child inherits the priority, the time slice and the tickets of its parent. */
 int sys_createprocess();
 
-/* Kill the process with the given pid; start looking for it from pcb */
+/* Kill the process with the given pid, which must be pcb or one of its descendants, and all
+ * of its progeny. pid=0 means pcb itself. */
 void sys_terminateprocess(pid_t p, struct pcb_t* pcb);
 
+/* Take a process with no children out of every kernel queue and free it, giving back the
+ * semaphore units it holds in the middle of a SEMOPV */
+void kill_pcb(struct pcb_t* pcb);
+
 /* Perform various operation on sempahores.
  *
  * We adopted a FIFO policy.  
@@ -50,17 +56,102 @@ void sys_terminateprocess(pid_t p, struct pcb_t* pcb);
  * Subsequent blocked process do not alter semaphore value, which get updated when it gets a new head. */
 int sys_semaphoreop(int * semaddr, int weight);
 
+/* Return the process which got the resources it waited for on a semaphore to its ready
+ * queue. If it was a timed P the process leaves the sleep queue too. */
+void sem_wake(struct pcb_t *pcb);
+
+/* Take pcb, which is waiting on a semaphore which is not a device one, out of it without
+ * giving it the resources, e.g. because it's being killed or its P timed out. */
+void sem_cancel_wait(struct pcb_t *pcb);
+
+/* Block the calling process on the device (or pseudo clock) semaphore sem until the
+ * interrupt handler wakes it up with dev_wake().
+ * A process waiting on a device semaphore waits for its own event (e.g. the end of its
+ * request), not for a V: the processes on it are woken up by pcb, whatever their position
+ * in the queue, and the value of the semaphore is minus the number of processes on it. */
+void dev_wait(int *sem);
+
+/* Wake up pcb, which is waiting on a device semaphore, passing it status in a1 */
+void dev_wake(struct pcb_t *pcb, unsigned int status);
+
+/* Take pcb, which is waiting on a device semaphore, out of it, e.g. because it's being
+ * killed: the event it waited for will find no one */
+void dev_cancel_wait(struct pcb_t *pcb);
+
+/* Return TRUE if a P of the given weight on semaddr would put the process on wait */
+bool sem_would_block(int *semaddr, int weight);
+
+/* Perform a vector of n semaphore operations atomically: either all of them are performed,
+ * or none. If some P can't be satisfied the process waits on the first such semaphore and,
+ * once it got it, issues the syscall again for the rest of the vector (p_semv_held).
+ * If the rest still can't be satisfied the held semaphore is released before waiting again,
+ * so the process never waits while holding a part of the vector.
+ * Return SEM_PROCESS_ERROR if n is out of [1, SEMOPV_MAX] or a semaphore is repeated. */
+int sys_semaphoreopv(struct semop_t *ops, int n);
+
+/* Return the index of the first P of a SEMOPV vector which would put the process on wait,
+ * or -1 if all of them can be satisfied now. The held operation is already performed. */
+int semopv_first_blocking(struct semop_t *ops, int n);
+
 /* Generic function to prepare the handlers.
  * exc_const are constants specifying which handler we're preparing (syscall, tlb or program trap).  */
 int sys_define_handler(memaddr pc, memaddr sp, unsigned int flags, unsigned int exc_const, unsigned int check_exc);
 
 /* Manage devices operation.
- * One operation per device is allowed; if a second operation request comes in, the calling process
- * get notified that the device is busy (and it's up to that process to eventually try again).
- * An eventual higher level library may manage a queue on a device to avoid busy waiting (like it
- * is done in the print function in p2test).  */
+ * One operation per device is in progress at a time; if a second operation request comes in, it
+ * is queued in the kernel and sent when the previous ones are over. In both cases the calling
+ * process waits on the device semaphore, until the interrupt handler wakes up the owner of the
+ * request which is over (sync_pid). */
 int sys_iodevop(unsigned int command, int intlNo, unsigned int dnum);
 
+/* Find the descriptor of device dnum on line intlNo and put in sub the subdevice dnum refers to
+ * (TERM_RECV for a terminal read, TERM_TRASM otherwise). Return NULL if there's no such device */
+struct dev_desc* io_desc(int intlNo, unsigned int dnum, int *sub);
+
+/* Send command to the subdevice sub of desc if it's ready. Return IO_DEV_NOT_INSTALLED,
+ * IO_DEV_BUSY or IO_DONE if the command has been sent */
+int io_start(struct dev_desc *desc, int sub, unsigned int command);
+
+/* Send command to the subdevice sub of desc on behalf of p if it's free, otherwise queue it
+ * (async is TRUE for an IODEVOPASYNC): the interrupt handler will send it when the requests
+ * before it are over, with the DATA0 it has now (but on terminals). A queued IODEVOP is recorded
+ * in p_ioreq. Return IO_DEV_NOT_INSTALLED, IO_DONE if the command has been sent, IO_QUEUED, or
+ * IO_DEV_BUSY if there's no memory to queue it or the disk is in use by the buffer cache */
+int io_submit(struct dev_desc *desc, int sub, unsigned int command, struct pcb_t *p, bool async);
+
+/* Take the IODEVOP queued by p out of its device request queue */
+void io_cancel(struct pcb_t *p);
+
+/* Send command to device dnum on line intlNo, as IODEVOP does, without waiting for it: the
+ * device status goes to the completion queue of the calling process, which is allocated
+ * the first time. Return IODEVOPASYNC_OK, IODEVOPASYNC_BUSY if the device is busy and there's no
+ * memory to queue the request, or
+ * IODEVOPASYNC_ERROR if there's no such device, no memory for the queue or the process has
+ * IO_CQ_SIZE requests not reaped yet */
+int sys_iodevop_async(unsigned int command, int intlNo, unsigned int dnum);
+
+/* Move the oldest completion of cq, if any, into out. Return 1 if there was one, 0 otherwise */
+int io_reap(struct io_cq *cq, struct io_completion *out);
+
+/* Start a TERMWRITE of the len (> 0) characters of buf on terminal dnum and block the calling
+ * process until the interrupt handler has transmitted them all, or a transmission error
+ * occurred. If the transmitter is busy the write is queued behind the requests before it,
+ * as an IODEVOP. Return IO_DEV_NOT_INSTALLED or IO_DEV_BUSY as sys_iodevop does, or
+ * IO_PROCESS_ON_WAIT. */
+int sys_termwrite(unsigned int dnum, char *buf, unsigned int len);
+
+/* Record on the terminal of desc the TERMWRITE of the len characters of buf by pid, whose
+ * first character has just been sent */
+void term_write_start(struct dev_desc *desc, char *buf, unsigned int len, pid_t pid);
+
+/* Read up to len (> 0) characters from terminal dnum into buf, stopping after a newline.
+ * The first call puts the terminal receiver in buffered mode. The characters already
+ * received are taken at once; if they are not enough, the calling process blocks and the
+ * interrupt handler copies the next ones into buf. done is the number of characters
+ * copied so far. Return IO_DEV_NOT_INSTALLED or IO_DEV_BUSY as sys_iodevop does,
+ * IO_DONE if the read is complete, or IO_PROCESS_ON_WAIT. */
+int sys_termread(unsigned int dnum, char *buf, unsigned int len, unsigned int *done);
+
 /* Save into given location user and global time */
 void sys_cputime(cputime_t *global, cputime_t *user);
 
@@ -73,17 +164,85 @@ void update_sys_time(unsigned int start_timestamp, struct pcb_t* pcb);
  * We assume arrays are allocated contiguously.  */
 bool is_device_sem(memaddr* addr);
 
-/* We chose to allocate the lowest free pid from a pool of MAXPROC pids. */
-pid_t generatePID();
+/* Allocate a pid for pcb: take the least recently freed slot of the pid table and tag its
+ * index with the generation of the slot. Return 0 if the table is full and can't grow. */
+pid_t generatePID(struct pcb_t *pcb);
+
+/* Give back the slot of pid to the pid table, moving it to its next generation */
+void releasePID(pid_t pid);
+
+/* Add a chunk of free slots, at their first generation, to the pid table.
+ * Return FALSE if the table reached its maximum size or there's no memory left. */
+bool pid_table_grow();
+
+/* Return the process with the given pid, or NULL if there's none (e.g. the pid is stale) */
+struct pcb_t* pid_lookup(pid_t pid);
+
+/* Fill the user buffer stats with the usage of the given kernel cache (KMEM_CACHE_PCB,
+ * KMEM_CACHE_SEMD, KMEM_CACHE_EXCP, KMEM_CACHE_IOCQ or KMEM_CACHE_IOREQ). Return the number of free pages left, or KMEMSTAT_ERROR if there's no
+ * such cache. */
+int sys_kmemstat(int which, struct kmem_stats *stats);
+
+/* Set the time slice of the calling process, in microseconds. Return the old one, or
+ * SETTIMESLICE_ERROR if the requested one is out of [SCHED_QUANTUM_MIN, SCHED_QUANTUM_MAX]. */
+int sys_settimeslice(cputime_t quantum);
+
+/* Set the stride scheduling tickets of the calling process. Return the old ones, or
+ * SETTICKETS_ERROR if the requested ones are out of [1, SCHED_TICKETS_MAX]. */
+int sys_settickets(unsigned int tickets);
+
+/* Make the calling process a real time process which runs up to budget microseconds every
+ * period microseconds, or a best effort one again if period is 0. Return 0, or
+ * SETREALTIME_ERROR if the parameters are out of range or the overall real time
+ * utilization would exceed SCHED_RT_MAX_UTIL per mille. */
+int sys_setrealtime(cputime_t period, cputime_t budget);
 
 /* Return the process pid */
 pid_t getPID();
 
+/* Set the priority of the calling process. Return the old priority, or
+ * SETPRIORITY_ERROR if the requested one is out of range.
+ * With MLFQ this is the highest level the process can reach, and it starts again from there. */
+int sys_setpriority(int prio);
+
 #define CREATE_PROCESS_ERROR -1
 
+#define SETPRIORITY_ERROR -1
+
+#define SETTIMESLICE_ERROR -1
+
+#define SETTICKETS_ERROR -1
+
+#define SETREALTIME_ERROR -1
+
+#define SLEEP_ERROR -1
+
 #define SEM_PROCESS_GO_ON 0
 #define SEM_PROCESS_ON_WAIT 1
 #define SEM_PROCESS_SCHEDULE_NEW 2
+#define SEM_PROCESS_ERROR 3
+
+#define SEMOPV_ERROR -1
+
+#define KMEMSTAT_ERROR -1
+
+#define TERMWRITE_ERROR -1
+
+#define TERMREAD_ERROR -1
+
+#define IODEVOPASYNC_OK 0
+#define IODEVOPASYNC_ERROR -1
+#define IODEVOPASYNC_BUSY -2
+
+#define IOREAP_ERROR -1
+
+// SEMOP results, in a1
+#define SEMOP_OK 0
+#define SEMOP_WOULDBLOCK -1
+#define SEMOP_TIMEDOUT -2
+
+// TRUE if p defined the handler check (CHECK_SYS_HDL, CHECK_TLB_HDL or CHECK_PGMT_HDL)
+#define HANDLER_DEFINED(p, check) ((p)->p_excp != NULL && (p)->p_excp->handler_defined[check])
 
 #define SPECHDL_GO_ON 0
 #define SPECHDL_SCHEDULE_NEW 1
@@ -91,6 +250,8 @@ pid_t getPID();
 #define IO_DEV_NOT_INSTALLED 0
 #define IO_DEV_BUSY 1
 #define IO_PROCESS_ON_WAIT 2
+#define IO_DONE 3
+#define IO_QUEUED 4
 
 #define CHECK_SYS_HDL 0
 #define CHECK_TLB_HDL 1
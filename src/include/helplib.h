@@ -18,8 +18,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-/* our implementation of the memset function offered by string.h
- * sets the object pointed by s to the value of c, byte by byte. */
+/* our implementations of the memset and memcpy functions offered by string.h:
+ * they move whole words (eight at a time with ldm/stm on arm) where the alignment allows
+ * it, and single bytes elsewhere. mymemcopy copies n bytes from "from" to "to". */
 
 #ifndef _HELPLIB 
 #define _HELPLIB
@@ -27,5 +28,11 @@
 void* mymemset(void* s, int c, size_t n);
 void mymemcopy(void* from, void* to, size_t n);
 
+/* index of the most significant set bit of x (x must not be 0) */
+int highest_bit(unsigned int x);
+
+/* index of the least significant set bit of x (x must not be 0) */
+int lowest_bit(unsigned int x);
+
 #endif
 
@@ -22,29 +22,54 @@
 #include <types.h>
 
 /* System interrupt handler function
- * We handle an interrupt at a time, the higher priority first */
+ * We handle every pending interrupt before returning, the higher priority lines first,
+ * and every device raising an interrupt on each line, so a burst of completions costs
+ * a single exception. */
 void Interrupt_Handler();
 
-/* Manage terminal devices */
-void terminal_handler();
-
-/* Find out the first device requesting an interrutp on a given line */
-int which_device_on_line(int which_int);
+/* Manage terminal devices: both a completed write and a completed read on the
+ * same terminal are handled in a single call */
+void terminal_handler(struct dev_desc *desc);
 
 /* Manage all devices but terminals */
-void generic_device_handler(int which_int);
-
-/* Check if the process which raised an interrupt and was blocked on the
- * corresponding real device semaphore has been killed */
-bool is_process_killed(int which_int);
+void generic_device_handler(struct dev_desc *desc);
 
-/* This function manages two system timers:
- *  - time slice: this is currently about 5ms, we assure every process to get its whole timeslice
- *      even if it has been interrupted
- *  - pseudo-clock timer: this is currently about 100ms. Due to several factors, we can't be sure
- *      about delays, but they don't add up since we use timestamps. */
+/* This function checks which timer events are due when the interval timer fires:
+ *  - pseudo-clock tick: this is currently 100ms. Ticks happen at fixed timestamps, so even if
+ *      the timer interrupt comes late delays don't add up. Ticks nobody waits for are skipped.
+ *  - time slice end: this is p_quantum (5ms by default) from the dispatch of curr_proc, it only matters if
+ *      there is a ready process which could take its place. For a real time process it's the
+ *      exhaustion of the budget of its job.
+ *  - real time job releases: real time processes waiting for their next period become ready.
+ *  - sleep expirations: processes whose SLEEP is over become ready.
+ * The timer itself is reprogrammed by set_next_timer(). */
 int manage_timers();
 
+/* Move pseudo_clock_start to the last pseudo clock tick before now */
+void pseudo_clock_sync(unsigned int now);
+
+/* Program the interval timer for the first timer event to come: the end of the time slice
+ * of curr_proc (if running is TRUE and some ready process competes with it), the next
+ * pseudo clock tick (if some process is waiting for it), the next real time job release,
+ * the first sleep expiration or the next MLFQ boost.
+ * If there are no events the timer is set to SCHED_BOGUS_SLICE, just to make sure. */
+void set_next_timer(bool running);
+
+/* Put p (which is not in any queue) to sleep for usec microseconds from now.
+ * The sleep queue is sorted by wake up time and each pcb keeps only the time between its
+ * wake up and the one of the previous pcb, so the timer only looks at the expired ones. */
+void sleep_insert(struct pcb_t *p, unsigned int usec);
+
+/* Take p out of the sleep queue before its wake up time */
+void sleep_out(struct pcb_t *p);
+
+/* Wake up the sleeping processes whose time has come */
+void sleep_wake_due(unsigned int now);
+
+/* Return TRUE and the wake up time of the first sleeping process in when, or FALSE
+ * if nobody is sleeping */
+bool sleep_next_wakeup(unsigned int *when);
+
 // These are used by the syscall handler and manage_timers to decide what to do next
 #define INT_PSEUDO_CLOCK_ENDED 0
 #define INT_TIME_SLICE_ENDED 1
@@ -0,0 +1,60 @@
+/* Kernel memory allocator
+ *
+ * A didactic simulation of an arm OS running on the uarm emulator.
+ * Copyright (C) 2016 Carlo De Pieri, Alessio Koci, Gianmaria Pedrini,
+ * Alessio Trivisonno
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _KMEM
+#define _KMEM
+
+#include <types.h>
+
+/*****************************************
+ * Kernel Memory Allocation              *
+ *****************************************/
+
+/* The kernel allocates its objects from the free RAM between the end of its image and the
+ * stacks at the top of RAM (the last KMEM_STACK_RESERVE bytes), a page at a time: so the
+ * number of processes and semaphores grows with the RAM of the machine.
+ * Pages are never given back. */
+
+/* Return a new page of KMEM_PAGE_SIZE bytes, or NULL if the free RAM is over */
+void *kmem_page_alloc(void);
+
+/* Return the number of pages which can still be allocated */
+unsigned int kmem_pages_free(void);
+
+/* Objects of the same type are allocated from a cache: a cache takes whole pages (slabs)
+ * and splits them into objects, freed objects are kept in the cache for later use. */
+
+/* Initialize an empty cache of objects of obj_size bytes (at most KMEM_PAGE_SIZE) */
+void kmem_cache_init(struct kmem_cache *cache, size_t obj_size);
+
+/* Return a free object of the cache, growing it by a slab if needed.
+ * Return NULL if the cache is empty and the free RAM is over */
+void *kmem_alloc(struct kmem_cache *cache);
+
+/* Grow the cache until it has n objects, free or in use: since slabs are never given back,
+ * n objects can be allocated from then on. Return FALSE if the free RAM is over */
+bool kmem_cache_reserve(struct kmem_cache *cache, unsigned int n);
+
+/* Give back an object to its cache */
+void kmem_free(struct kmem_cache *cache, void *obj);
+
+/* Fill stats with the usage of the cache */
+void kmem_cache_stats(struct kmem_cache *cache, struct kmem_stats *stats);
+
+#endif
@@ -26,13 +26,29 @@
  * The Allocation and Deallocation of ProcBlk's *
  ************************************************/
 
-/*insert the element pointed to by p onto the pcbFree list*/
+/*give back the element pointed to by p to the pcb cache*/
 void freePcb(struct pcb_t *p);
 
-/*return an element from the freePcb list*/
+/*return a new pcb, NULL if there's no more memory for it*/
 struct pcb_t *allocPcb();
 
-/*allocate pcbs and fill freePcb - run once*/
+/*return a new pcb like allocPcb, but without clearing it all: only the links, the counters
+ *and the fields the kernel reads before writing them are initialized. The processor state,
+ *the pid and the scheduling parameters (p_prio, p_base_prio, p_quantum, p_tickets, p_pass)
+ *are left to the caller, the real time and sleep fields are set when the process enters
+ *those states, and the extensions are attached only when needed.
+ *NULL if there's no more memory*/
+struct pcb_t *allocPcbLazy();
+
+/*attach a new, empty exception handler extension to p and return it, NULL if there's
+ *no more memory for it*/
+struct pcb_excp_t *allocExcp(struct pcb_t *p);
+
+/*attach a new, empty I/O completion queue to p and return it, NULL if there's no more
+ *memory for it*/
+struct io_cq *allocIocq(struct pcb_t *p);
+
+/*initialize the pcb caches - run once*/
 void initPcbs(void);
 
 /*****************************
@@ -41,23 +57,27 @@ void initPcbs(void);
 
 /*Insert the ProcBlk pointed to by p into the process queue whose list-tail*/
 /*pointer is q.*/
-void insertProcQ(struct clist *q, struct pcb_t *p);
+void insertProcQ(struct dlist *q, struct pcb_t *p);
+
+/*Insert the ProcBlk pointed to by p into the process queue whose list-tail*/
+/*pointer is q, just before the ProcBlk pointed to by next, which is in q.*/
+void insertProcQBefore(struct dlist *q, struct pcb_t *p, struct pcb_t *next);
 
 /*Remove the first (i.e. head) element from the process queue whose list-*/
 /*tail pointer is q. Return NULL if the process queue was initially empty;*/
 /*otherwise return the pointer to the removed element.*/
-struct pcb_t *removeProcQ(struct clist *q);
+struct pcb_t *removeProcQ(struct dlist *q);
 
 /*Remove the ProcBlk pointed to by p from the process queue whose list-tail*/
 /*pointer is q. If the desired entry is not in the indicated queue (an error*/
 /*condition), return NULL; otherwise, return p. Note that p can point to*/
 /*any element of the process queue.*/
-struct pcb_t *outProcQ(struct clist *q, struct pcb_t *p);
+struct pcb_t *outProcQ(struct dlist *q, struct pcb_t *p);
 
 /*Return a pointer to the first ProcBlk from the process queue whose list-*/
 /*tail pointer is q. Do not remove this ProcBlk from the process queue.*/
 /*Return NULL if the process queue is empty.*/
-struct pcb_t *headProcQ(struct clist *q);
+struct pcb_t *headProcQ(struct dlist *q);
 
 /****************************
  * Process Tree Maintenance *
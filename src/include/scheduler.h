@@ -27,9 +27,94 @@
 #define SCHED_PROC_KILLED 2
 #define SCHED_NEARWAIT 3
 #define SCHED_PROC_BLOCKED 4
+#define SCHED_PROC_PREEMPTED 5
+
+#define IS_RT(p) ((p)->p_rt_period != 0)
 
 /* Main scheduler function. It's argument its used to take different action based on where the
  * scheduler is called from.
- * This is a simple round robin scheduler. */
+ * Real time processes run first, earliest deadline first. Then this is a strict priority
+ * scheduler: the highest priority ready process always runs, processes with the same
+ * priority are scheduled round robin (or by stride, see const.h). */
 void schedule(int state);
+
+/* Insert a pcb at the tail of the ready queue of its priority.
+ * With stride scheduling the queue is kept sorted by pass instead.
+ * Real time processes go into their own queue, sorted by deadline. */
+void ready_insert(struct pcb_t *p);
+
+/* Remove and return the earliest deadline real time process, or else the head of the
+ * highest priority non empty ready queue. Return NULL if there's no ready process. */
+struct pcb_t* ready_remove();
+
+/* Remove the given pcb from its ready queue. Return NULL if it was not there. */
+struct pcb_t* ready_out(struct pcb_t *p);
+
+/* Return TRUE if there's no ready process */
+bool ready_empty();
+
+/* Policy hook, called when the time slice of p has ended. With MLFQ p is demoted.
+ * For real time processes this means that the job used up its budget. */
+void sched_slice_ended(struct pcb_t *p);
+
+/* Policy hook, called when p has been preempted by a higher priority process. */
+void sched_preempted(struct pcb_t *p);
+
+/* Policy hook, called when p is about to block. on_io is TRUE if p is blocking on a device
+ * or on the pseudo clock. With MLFQ p is boosted if it's waiting for I/O, otherwise it's
+ * demoted if it used up its time allotment. */
+void sched_blocked(struct pcb_t *p, bool on_io);
+
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+/* Move a process which is not in a ready queue to the given MLFQ level, bounded by
+ * SCHED_PRIO_MIN and its base priority. Its time allotment starts again. */
+void mlfq_set_level(struct pcb_t *p, int level);
+
+/* Anti starvation boost: every ready process (and curr_proc) gets back to its base
+ * priority, so CPU bound processes demoted to the lowest levels can't starve forever. */
+void mlfq_boost();
+#endif
+
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+/* Advance the pass of a process which is leaving the CPU by its stride for each
+ * SCHED_STRIDE_UNIT of cpu time it used since its dispatch (rounded up, so a process
+ * can't run for free by blocking early). */
+void stride_charge(struct pcb_t *p);
+#endif
+
+/* Return TRUE if the end of the time slice of curr_proc matters, i.e. if there's a ready
+ * process which could run in its place, or if curr_proc is a real time job with a budget. */
+bool slice_needed();
+
+/* Return TRUE if a ready process has a higher priority than curr_proc: a real time
+ * process with an earlier deadline, or any real time process if curr_proc is not one */
+bool need_resched();
+
+/* Load the given state into the processor, unless a process with a higher priority than
+ * curr_proc became ready in the meantime: in that case curr_proc is preempted. */
+void resume_or_preempt(state_t* area);
+
+/* Make p (which is curr_proc, or not in any queue) a real time process with the given
+ * period and budget, its first job is released now. Return FALSE if the overall utilization
+ * of real time processes would exceed SCHED_RT_MAX_UTIL. */
+bool rt_enter(struct pcb_t *p, cputime_t period, cputime_t budget);
+
+/* Make p a best effort process again. If it's waiting for its next job it's taken out
+ * of the release queue, the caller must take care of any other queue. */
+void rt_leave(struct pcb_t *p);
+
+/* Charge the cpu time p used since its dispatch to the budget of its current job */
+void rt_charge(struct pcb_t *p);
+
+/* End the current job of p, which is not in any queue: p waits for the release of its next
+ * job at the next period boundary. If that's already passed the missed periods are skipped
+ * and p is ready again. */
+void rt_wait_next_period(struct pcb_t *p);
+
+/* Release the real time jobs whose release time has come */
+void rt_release_due(unsigned int now);
+
+/* Return TRUE and the release time of the first job to be released in when, or FALSE
+ * if no real time process is waiting */
+bool rt_next_release(unsigned int *when);
 #endif
@@ -46,10 +46,132 @@ struct clist {
     struct clist *next;
 };
 
+/* struct dlist definition: as struct clist, plus a back link so that an
+ * element can be unlinked without scanning the list (see dlist.h). */
+
+struct dlist {
+    struct dlist *next;
+    struct dlist *prev;
+};
+
 struct semd_t {
         int *s_semAdd; /* pointer to the semaphore */
-        struct clist s_link; /* ASL linked list */
-        struct clist s_procq; /* blocked process queue */
+        struct dlist s_link; /* ASL hash bucket */
+        struct dlist s_procq; /* blocked process queue */
+};
+
+/* A TERMWRITE in progress on a terminal: the interrupt handler transmits the
+ * characters one after the other and wakes up the writer at the end */
+struct term_write {
+    char *buf; /* next character to transmit, NULL if there's no write in progress */
+    unsigned int left; /* characters still to transmit */
+    unsigned int done; /* characters transmitted */
+    pid_t pid; /* the writer, other processes may wait on the semaphore for their IODEVOP */
+};
+
+/* The input of a terminal read with TERMREAD: from the first TERMREAD on, the interrupt
+ * handler keeps the receiver busy and stores the characters nobody is waiting for */
+struct term_read {
+    char ring[TERM_RING_SIZE];
+    unsigned int head; /* index of the first character in the ring */
+    unsigned int count; /* characters in the ring */
+    bool active; /* the receiver is in buffered mode */
+};
+
+/* A disk block in the buffer cache, see bcache.h */
+struct buf {
+    struct dlist b_lru; /* buffers in use, least recently used first */
+    unsigned int b_disk; /* disk number */
+    unsigned int b_block; /* linear block number */
+    int b_state; /* BUF_EMPTY, BUF_VALID, BUF_READ, BUF_WRITE or BUF_ERROR */
+    bool b_dirty; /* the block has been written and not written back yet */
+    bool b_seeked; /* the seek of the operation in progress is over */
+    int b_sem; /* processes waiting for the end of the operation in progress */
+    void *b_data; /* the block, a kmem page */
+};
+
+/* An IODEVOP or IODEVOPASYNC waiting for its device to be free */
+struct io_req {
+    struct clist link; /* device request queue */
+    struct clist *rq; /* the queue the request is in */
+    unsigned int command;
+    memaddr data0; /* DATA0 register when it was queued, not for terminals */
+    pid_t pid; /* process which issued it */
+    bool async; /* TRUE for IODEVOPASYNC */
+    struct buf *buf; /* buffer cache operation (pid is 0), or NULL */
+    char *wr_buf; /* the characters of a TERMWRITE, or NULL */
+    unsigned int wr_len;
+};
+
+/* Device descriptor, filled in at boot for every device: its registers and the
+ * semaphores the processes waiting for it block on. Terminals use both sem[TERM_TRASM]
+ * and sem[TERM_RECV], the other devices only sem[TERM_TRASM] (sem[TERM_RECV] is NULL) */
+struct dev_desc {
+    devreg_t *reg;
+    int line; /* interrupt line */
+    int dev; /* device number */
+    int *sem[TERM_SUBDEV];
+    pid_t async_pid[TERM_SUBDEV]; /* process which issued an IODEVOPASYNC in progress, or 0 */
+    pid_t sync_pid[TERM_SUBDEV]; /* process which issued an IODEVOP in progress, or 0 */
+    struct clist rq[TERM_SUBDEV]; /* requests waiting for the end of the one in progress */
+    struct term_write wr; /* terminals only */
+    struct term_read *rd; /* terminals only, NULL for the other devices */
+    struct buf *buf_op; /* disks only: buffer cache operation in progress, or NULL */
+};
+
+/* A slot of the pid table: the process using it, if any, and its current generation */
+struct pid_entry {
+    struct pcb_t *pcb;
+    unsigned int gen;
+    int next_free; /* next slot in the free slots FIFO */
+};
+
+/* A cache of kernel objects of the same size, see kmem.h */
+struct kmem_cache {
+    size_t obj_size; /* size of the objects, word aligned */
+    unsigned int slab_objs; /* objects in a slab (a page) */
+    void *free; /* free objects */
+    unsigned int total; /* objects in the slabs of the cache */
+    unsigned int in_use; /* objects allocated */
+    unsigned int slabs; /* pages taken by the cache */
+};
+
+/* Usage statistics of a kmem_cache, returned by KMEMSTAT */
+struct kmem_stats {
+    unsigned int obj_size;
+    unsigned int total;
+    unsigned int in_use;
+    unsigned int slabs;
+};
+
+/* An operation of a SEMOPV vector: weight has the same meaning as in SEMOP */
+struct semop_t {
+    int *semaddr;
+    int weight;
+};
+
+/* The completion of an IODEVOPASYNC, returned by IOREAP */
+struct io_completion {
+    int line; /* interrupt line of the device */
+    unsigned int dnum; /* device number, as passed to IODEVOPASYNC */
+    unsigned int status; /* device status */
+};
+
+/* The asynchronous I/O completion queue of a process, allocated with its first
+ * IODEVOPASYNC. pending never exceeds IO_CQ_SIZE, so there's always room for a completion */
+struct io_cq {
+    struct io_completion ring[IO_CQ_SIZE];
+    unsigned int head; /* index of the oldest completion */
+    unsigned int count; /* completions not reaped yet */
+    unsigned int pending; /* requests not reaped yet, completed or not */
+    bool waiting; /* TRUE if the process is blocked in IOREAP */
+};
+
+/* The cold part of a pcb: the exception states of the handlers defined with SPEC*HDL.
+ * Most processes never define one, so it's allocated the first time they do. */
+struct pcb_excp_t {
+    state_t p_excpvec[EXCP_COUNT]; /*exception states vector*/
+    bool handler_defined[3]; //0 sys, 1 tlb, 2 pgmt
 };
 
 struct pcb_t {
@@ -58,8 +180,7 @@ struct pcb_t {
                                 which process blocked */
     pid_t p_pid;
     state_t p_s; /* processor state */
-    state_t p_excpvec[EXCP_COUNT]; /*exception states vector*/
-    bool handler_defined[3]; //0 sys, 1 tlb, 2 pgmt
+    struct pcb_excp_t *p_excp; /* exception handlers, NULL if none was defined */
     cputime_t sys_time;
     cputime_t usr_time;
     // stores the number of initial resources requested from the semaphore on which
@@ -67,9 +188,28 @@ struct pcb_t {
     // should be 0 otherwise.
     int s_req_weight;
     int user_enter_timestamp;
-    struct clist p_list; /* process list */
-    struct clist p_children; /* children list entry point*/
-    struct clist p_siblings; /* children list: links to the siblings */
+    int p_prio; /* priority, selects the ready queue the process is inserted into */
+    int p_base_prio; /* priority requested by the process, p_prio can only differ with MLFQ */
+    cputime_t p_level_start; /* cpu time used when the process entered its current MLFQ level */
+    cputime_t p_quantum; /* length of the time slice of the process */
+    unsigned int p_tickets; /* CPU share of the process with stride scheduling */
+    unsigned int p_pass; /* stride scheduling virtual time, the lowest pass runs first */
+    cputime_t p_run_start; /* cpu time used when the process was last dispatched */
+    cputime_t p_rt_period; /* real time period, 0 for best effort processes */
+    cputime_t p_rt_budget; /* cpu time each real time job can use */
+    int p_rt_budget_left; /* cpu time the current job can still use */
+    unsigned int p_rt_release; /* timestamp of the release of the current job */
+    unsigned int p_rt_deadline; /* timestamp of the deadline of the current job */
+    bool p_rt_waiting; /* TRUE if the process is waiting for the release of its next job */
+    unsigned int p_sleep_delta; /* time between the wake up of the previous sleeping process and this one */
+    bool p_sleeping; /* TRUE if the process is in the sleep queue */
+    struct semop_t *p_semv_held; /* SEMOPV operation already performed while waiting for it */
+    struct io_cq *p_iocq; /* asynchronous I/O completions, NULL if the process never used it */
+    struct io_req *p_ioreq; /* IODEVOP queued on a busy device, NULL if none */
+    struct dlist p_list; /* process list */
+    struct dlist *p_queue; /* the process queue p_list is linked in, NULL if none */
+    struct dlist p_children; /* children list entry point*/
+    struct dlist p_siblings; /* children list: links to the siblings */
 };
 
 #endif
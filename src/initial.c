@@ -27,6 +27,7 @@
 #include <asl.h>
 #include <clist.h>
 #include <helplib.h>
+#include <kmem.h>
 // phase 2 libs
 #include <interrupts.h>
 #include <exceptions.h>
@@ -42,9 +43,16 @@
 //init scheduler variables
 int proc_count = 0;
 int softblock_count = 0;
-bool free_pidmap[MAXPROC];
-static struct clist ready_queue_list = CLIST_INIT;
-struct clist* ready_queue = &ready_queue_list;
+// pid table: slot PID_INDEX(pid) holds the process with that pid, if the generation matches.
+// It grows by chunks: slot i is pid_dir[i / PID_CHUNK_SIZE][i % PID_CHUNK_SIZE]
+struct pid_entry *pid_dir[PID_DIR_SIZE];
+int pid_slots = 0;
+// free slots, in FIFO order so that a slot is reused as late as possible (-1 if none)
+int pid_free_head = -1;
+int pid_free_tail = -1;
+// one ready queue per priority level, bit n of ready_bitmap is set if ready_queues[n] is not empty
+struct dlist ready_queues[SCHED_PRIO_LEVELS];
+unsigned int ready_bitmap = 0;
 struct pcb_t* curr_proc;
 
 //init device and clock semaphores
@@ -52,10 +60,20 @@ struct pcb_t* curr_proc;
 int s_dev_array[DEV_USED_INTS-1][DEV_PER_INT]; // [int-line][dev-num]
 int s_term_array[DEV_PER_INT][TERM_SUBDEV]; // [term-num][0 == WRITE 1 == READ]
 int s_pseudo_clock_timer = 0;
+// device descriptors, so the interrupt handler and IODEVOP don't compute register
+// addresses and semaphore indexes every time
+struct dev_desc dev_table[DEV_USED_INTS][DEV_PER_INT]; // [int-line - INT_LOWEST][dev-num]
+// input buffers of the terminals
+struct term_read term_rd[DEV_PER_INT];
 
-extern int pseudo_clock_start;
+extern unsigned int pseudo_clock_start;
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+extern unsigned int mlfq_boost_start;
+#endif
+extern struct kmem_cache ioreq_cache;
+extern struct kmem_cache semd_cache;
 extern void test();
-extern pid_t generatePID();
+extern pid_t generatePID(struct pcb_t *pcb);
 
 int main(){
 //initialize nucleus
@@ -96,17 +114,36 @@ int main(){
     Syscall_New->cpsr = STATUS_SYS_MODE;
     Syscall_New->cpsr = STATUS_ALL_INT_DISABLE(Syscall_New->cpsr);
 
+    //fill in the device descriptors
+    for(int line = INT_LOWEST; line < INT_LOWEST + DEV_USED_INTS; line++){
+        for(int dev = 0; dev < DEV_PER_INT; dev++){
+            struct dev_desc* desc = &(dev_table[line - INT_LOWEST][dev]);
+            desc->reg = (devreg_t*) DEV_REG_ADDR(line, dev);
+            desc->line = line;
+            desc->dev = dev;
+            desc->buf_op = NULL;
+            if(line == IL_TERMINAL){
+                desc->sem[TERM_TRASM] = &(s_term_array[dev][TERM_TRASM]);
+                desc->sem[TERM_RECV] = &(s_term_array[dev][TERM_RECV]);
+                desc->rd = &(term_rd[dev]);
+            }
+            else {
+                desc->sem[TERM_TRASM] = &(s_dev_array[line - INT_LOWEST][dev]);
+                desc->sem[TERM_RECV] = NULL;
+                desc->rd = NULL;
+            }
+        }
+    }
+
     //allocate pcbs and semaphores
     initPcbs();
     initASL();
+    kmem_cache_init(&ioreq_cache, sizeof(struct io_req));
     
-    //initialize to 0 all free_pidmap elements
-    for(int i=0; i<MAXPROC; i++)
-        free_pidmap[i] = TRUE;
-
     //instantiate test process
     struct pcb_t* test_pcb = allocPcb();
-    if(test_pcb == NULL)
+    // with its semaphore descriptor, see sys_createprocess()
+    if(test_pcb == NULL || !kmem_cache_reserve(&semd_cache, 1))
         PANIC();
     //set System Mode with interrupts enabled
     test_pcb->p_s.cpsr = STATUS_SYS_MODE;
@@ -114,12 +151,21 @@ int main(){
     test_pcb->p_s.CP15_Control = CP15_DISABLE_VM(test_pcb->p_s.CP15_Control);
     test_pcb->p_s.sp = ramtop - FRAMESIZE;
     test_pcb->p_s.pc = (memaddr) test;
-    test_pcb->p_pid = generatePID();
-    insertProcQ(ready_queue, test_pcb);
+    test_pcb->p_pid = generatePID(test_pcb);
+    if(test_pcb->p_pid == 0)
+        PANIC();
+    test_pcb->p_prio = SCHED_PRIO_DEFAULT;
+    test_pcb->p_base_prio = SCHED_PRIO_DEFAULT;
+    test_pcb->p_quantum = SCHED_TIME_SLICE;
+    test_pcb->p_tickets = SCHED_TICKETS_DEFAULT;
+    ready_insert(test_pcb);
     proc_count++;
 
     //initialize pseudoclock timestamp
     pseudo_clock_start = getTODLO();
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+    mlfq_boost_start = pseudo_clock_start;
+#endif
 
     //call the scheduler
     schedule(SCHED_INIT);
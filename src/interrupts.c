@@ -25,10 +25,14 @@
 #include <asl.h>
 #include <pcb.h>
 #include <clist.h>
+#include <dlist.h>
+#include <helplib.h>
+#include <kmem.h>
 // phase 2 libs
 #include <scheduler.h>
 #include <exceptions.h>
 #include <interrupts.h>
+#include <bcache.h>
 // uARM libs
 #include <libuarm.h>
 #include <arch.h>
@@ -37,23 +41,29 @@
 #include <debug.h>
 #endif
 
-extern int curr_proc_time_left;
-extern int next_time_slice;
+extern unsigned int slice_end;
 extern int s_pseudo_clock_timer;
-extern struct clist* ready_queue;
 extern int softblock_count;
 extern bool nearwait;
-extern int s_dev_array[DEV_USED_INTS - 1][DEV_PER_INT];
-extern int s_term_array[DEV_PER_INT][TERM_SUBDEV];
+extern struct dev_desc dev_table[DEV_USED_INTS][DEV_PER_INT];
+extern struct kmem_cache ioreq_cache;
 extern struct pcb_t* curr_proc;
 
 // a timestamp of the last pseudo-clock start time
-int pseudo_clock_start;
-// a time slice has been split!
-int time_slice_split = 0;
+unsigned int pseudo_clock_start;
+// sleeping processes, sorted by wake up time, each with its delta from the previous one
+static struct dlist sleep_queue = DLIST_INIT;
+// the timestamp the delta of the head of sleep_queue refers to
+static unsigned int sleep_base;
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+// a timestamp of the last MLFQ boost
+unsigned int mlfq_boost_start;
+#endif
 
 /* System interrupt handler function
- * We handle an interrupt at a time, the higher priority first */
+ * We handle every pending interrupt before returning, the higher priority lines first,
+ * and every device raising an interrupt on each line, so a burst of completions costs
+ * a single exception. */
 void Interrupt_Handler(){
     // recover processor state and read CP15_Cause
     state_t* oldarea = (state_t*) INT_OLDAREA;
@@ -62,49 +72,63 @@ void Interrupt_Handler(){
     // set the right return address in the pc (manual sec 8.3)
     oldarea->pc = oldarea->pc - 4;
 
-    int which_int;
+    bool slice_ended = FALSE;
+    // bit n is set if line n is pending: the lowest set bit is the higher priority line
+    unsigned int lines = (cause >> CAUSE_IP_SHIFT) & ((1 << FIRST_EMPTY_INT) - 1);
 
-    // select the higher priority interrupt
-    for (which_int = 0; which_int < FIRST_EMPTY_INT; which_int++) {
-        if (CAUSE_IP_GET(cause, which_int)){
-            break;
-        }
-    }
+    while (lines) {
+        int which_int = lowest_bit(lines);
+        lines &= lines - 1;
 
-    switch (which_int){
-
-        case IL_TIMER:
-            // Interval timer interrupt
-            {{
-                 // manage interval timer
-                 int result = manage_timers();
-                 if(result==INT_TIME_SLICE_ENDED) {
-                     // call the scheduler only if the time slice has ended
-                     // AND we're not in nearwait state (that's controlled
-                     // inside manage_timers())
-                     // update usr time if the interrupt happened when a usr process was running
-                     if (!nearwait)
-                         update_usr_time(oldarea->TOD_Low, curr_proc);
-                     schedule(SCHED_TIME_SLICE_ENDED);
-                 }
-                 // in every other cases just go on
-                 // (those cases are INT_PSEUDO_CLOCK_ENDED and PROCESSOR_TWIDDLING_ITS_THUMBS;
-                 // those constants are not used right now, because (later on) we check
-                 // the variable nearwait to decide what to do)
-             }}
-            break;
+        switch (which_int){
 
-        case IL_TERMINAL:
-            {{
-                 terminal_handler();
-                 //handle the result differently
-             }}
-            break;
+            case IL_TIMER:
+                // Interval timer interrupt
+                {{
+                     // manage interval timer
+                     // the scheduler is called only after the device lines have been served,
+                     // and only if the time slice has ended
+                     // (manage_timers() never returns it in nearwait state)
+                     if(manage_timers() == INT_TIME_SLICE_ENDED)
+                         slice_ended = TRUE;
+                     // in every other cases just go on
+                     // (those cases are INT_PSEUDO_CLOCK_ENDED and PROCESSOR_TWIDDLING_ITS_THUMBS;
+                     // those constants are not used right now, because (later on) we check
+                     // the variable nearwait to decide what to do)
+                 }}
+                break;
 
-        default:
-            generic_device_handler(which_int);
-            break;
+            case IL_TERMINAL:
+                {{
+                     // bitmap has the nth bit = 1 if the nth device is raising an interrupt
+                     unsigned int bitmap = *((memaddr*) CDEV_BITMAP_ADDR(IL_TERMINAL));
+                     while(bitmap){
+                         terminal_handler(&(dev_table[IL_TERMINAL - INT_LOWEST][lowest_bit(bitmap)]));
+                         bitmap &= bitmap - 1;
+                     }
+                 }}
+                break;
+
+            default:
+                {{
+                     if(which_int < INT_LOWEST)
+                         // not a device line
+                         break;
+                     unsigned int bitmap = *((memaddr*) CDEV_BITMAP_ADDR(which_int));
+                     while(bitmap){
+                         generic_device_handler(&(dev_table[which_int - INT_LOWEST][lowest_bit(bitmap)]));
+                         bitmap &= bitmap - 1;
+                     }
+                 }}
+                break;
 
+        }
+    }
+
+    if(slice_ended && !nearwait){
+        // update usr time since the interrupt happened when a usr process was running
+        update_usr_time(oldarea->TOD_Low, curr_proc);
+        schedule(SCHED_TIME_SLICE_ENDED);
     }
 
     if(nearwait){
@@ -120,172 +144,369 @@ void Interrupt_Handler(){
     else {
         // update user time if the interrupt happened when a user process was running
         update_usr_time(oldarea->TOD_Low, curr_proc);
-    }
-
-    if(time_slice_split){
-        // a process time slice was split, the settimer is here to be more accurate
-        setTIMER(curr_proc_time_left);
-        curr_proc_time_left = 0;
-        time_slice_split = 0;
+        if(need_resched()){
+            // the interrupt woke up a process with higher priority than curr_proc:
+            // the scheduler will give it a new time slice
+            curr_proc->p_s = *oldarea;
+            schedule(SCHED_PROC_PREEMPTED);
+        }
+        // the interrupt could have made ready a process competing with curr_proc, and
+        // a timer interrupt must be acknowledged anyway
+        set_next_timer(TRUE);
     }
     LDST((void*)oldarea);
 }
 
-/* This function manages two system timers:
- *  - time slice: this is currently about 5ms, we assure every process to get its whole timeslice
- *      even if it has been interrupted
- *  - pseudo-clock timer: this is currently about 100ms. Due to several factors, we can't be sure
- *      about delays, but they don't add up since we use timestamps. */
-int manage_timers(int which_int){
-    if(( getTODLO()-pseudo_clock_start ) >= SCHED_PSEUDO_CLOCK ){
-        // pseudo clock ended
-        // the pseudo_clock_timer could get to 105ms at most
+/* This function checks which timer events are due when the interval timer fires:
+ *  - pseudo-clock tick: this is currently 100ms. Ticks happen at fixed timestamps, so even if
+ *      the timer interrupt comes late delays don't add up. Ticks nobody waits for are skipped.
+ *  - time slice end: this is p_quantum (5ms by default) from the dispatch of curr_proc, it only matters if
+ *      there is a ready process which could take its place. For a real time process it's the
+ *      exhaustion of the budget of its job.
+ *  - real time job releases: real time processes waiting for their next period become ready.
+ *  - sleep expirations: processes whose SLEEP is over become ready.
+ * The timer itself is reprogrammed by set_next_timer(). */
+int manage_timers(){
+    unsigned int now = getTODLO();
+    int result = INT_PSEUDO_CLOCK_ENDED;
 
-        // unblock processes on the pseudo_clock_timer
-        while(headBlocked(&(s_pseudo_clock_timer))!=NULL){
-            insertProcQ(ready_queue, removeBlocked(&(s_pseudo_clock_timer)));
-            softblock_count--;
-        }
+    if(now - pseudo_clock_start >= SCHED_PSEUDO_CLOCK){
+        // pseudo clock ended
+        // unblock processes on the pseudo_clock_timer: the whole queue is detached
+        // from the ASL at once, then each process goes to its own ready queue
+        struct dlist waiters = DLIST_INIT;
+        struct pcb_t* p;
+        softblock_count -= removeAllBlocked(&(s_pseudo_clock_timer), &waiters);
+        while((p = removeProcQ(&waiters)) != NULL)
+            ready_insert(p);
         // reset the pseudo clock timer semaphore
         s_pseudo_clock_timer = 0;
+        // adjust the pseudo_clock_start timestamp not considering delays
+        pseudo_clock_sync(now);
+    }
 
-        // adjust the next pseudo_clock_start timer not considering delays
-        pseudo_clock_start = SCHED_PSEUDO_CLOCK + pseudo_clock_start;
-
-        if(nearwait) { 
-            // the processor was in wait state, the Interrupt Handler will call the scheduler
-            // to handle the processes just freed (if any)
-            // We set the timer at SCHED_PSEUDO_CLOCK because, even if there's no more process to unblock, we
-            // need to keep pseudo_clock_start updated. If a process arrive on the ready_queue somehow,
-            // the scheduler will correctly reset the timer
-            setTIMER(SCHED_PSEUDO_CLOCK);
-            return PROCESSOR_TWIDDLING_ITS_THUMBS;
-        }
-        else {
-            if(curr_proc_time_left>0){
-                // this happens if we split a process time slice before therefore the curr_proc has
-                // still some time left from his time slice
-                // this flag will allow to set the timer later (near the LDST)
-                time_slice_split = 1;
-                return INT_PSEUDO_CLOCK_ENDED;
-            }
-            else {
-                // we get here if we didn't split a process time slice therefore the curr_proc already
-                // had all the time slice
-                // this happens if the proc started before 95ms and ended after 100ms because of additional time
-                // spent with interrupts masked for whatever reason
-                next_time_slice = SCHED_TIME_SLICE;
-                // since we are not in wait state we let the scheduler set the timer (therefore sending the ack)
-                return INT_TIME_SLICE_ENDED;
-            }
-        }
+    // release the real time jobs whose period has started
+    rt_release_due(now);
+    // wake up the processes whose sleep is over
+    sleep_wake_due(now);
+
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+    if(now - mlfq_boost_start >= SCHED_MLFQ_BOOST_PERIOD){
+        mlfq_boost();
+        mlfq_boost_start = now;
     }
-    else {
-        // time slice ended
-        if(nearwait) { 
-            // the processor was in wait state, the Interrupt Handler will call the scheduler
-            // and it will wait again because we haven't freed any process
-            // We set the timer to wake us at the next pseudo clock timer tick since there's no process
-            // in the ready queue: there's no need of time slices and we only care about pseudo clock timer
-            // (remember: if other [devices] interrutps happen, the scheduler will restart the proper time slice cycle)
-            setTIMER(SCHED_PSEUDO_CLOCK - (getTODLO()-pseudo_clock_start));
-            return PROCESSOR_TWIDDLING_ITS_THUMBS;
-        }        
-        else { 
-            // check how close we are to the pseudo clock tick
-            int pseudo_clock_delta = getTODLO()-pseudo_clock_start;
-
-            if(pseudo_clock_delta > (SCHED_PSEUDO_CLOCK - SCHED_TIME_SLICE)){
-                // there's no time for another full time slice, we'll split the next one
-                // how much the next process will need to advance AFTER the tick from the pseudo_clock_timer
-                curr_proc_time_left = SCHED_TIME_SLICE - (SCHED_PSEUDO_CLOCK - pseudo_clock_delta);
-                // how much the next process will need to advance BEFORE the tick from the pseudo_clock_timer
-                next_time_slice = SCHED_PSEUDO_CLOCK - pseudo_clock_delta;
-            }
-            else next_time_slice = SCHED_TIME_SLICE;
-
-            // call the scheduler
-            return INT_TIME_SLICE_ENDED;
-        }    
+#endif
+
+    if(nearwait){
+        // the processor was in wait state, the Interrupt Handler will call the scheduler
+        // to handle the processes just freed (if any), and the scheduler will set the timer
+        return PROCESSOR_TWIDDLING_ITS_THUMBS;
+    }
+    if((int)(now - slice_end) >= 0 && slice_needed()){
+        // time slice ended, call the scheduler
+        result = INT_TIME_SLICE_ENDED;
     }
+    return result;
 }
 
-/* Find out the first device requesting an interrutp on a given line */
-int which_device_on_line(int which_int){
-
-    // Decide which dev is raising an interrupt
-    // bitmap has the nth bit = 1 if the nth device is raising an interrupt
-    unsigned int bitmap;
-    int which_dev;
-    bitmap = * ((memaddr*) CDEV_BITMAP_ADDR(which_int));
-    for (which_dev = 0; which_dev < DEV_PER_INT; which_dev++) {
-        if(bitmap & 1) break;
-        bitmap = bitmap >> 1;
+/* Move pseudo_clock_start to the last pseudo clock tick before now */
+void pseudo_clock_sync(unsigned int now){
+    pseudo_clock_start += ((now - pseudo_clock_start) / SCHED_PSEUDO_CLOCK) * SCHED_PSEUDO_CLOCK;
+}
+
+/* Program the interval timer for the first timer event to come: the end of the time slice
+ * of curr_proc (if running is TRUE and some ready process competes with it), the next
+ * pseudo clock tick (if some process is waiting for it), the next real time job release,
+ * the first sleep expiration or the next MLFQ boost.
+ * If there are no events the timer is set to SCHED_BOGUS_SLICE, just to make sure. */
+void set_next_timer(bool running){
+    unsigned int now = getTODLO();
+    unsigned int delay = SCHED_BOGUS_SLICE;
+    unsigned int release;
+    int left;
+
+    if(running && slice_needed()){
+        left = slice_end - now;
+        if(left < (int) delay) delay = left;
+    }
+    if(headBlocked(&(s_pseudo_clock_timer)) != NULL){
+        left = pseudo_clock_start + SCHED_PSEUDO_CLOCK - now;
+        if(left < (int) delay) delay = left;
+    }
+    if(rt_next_release(&release)){
+        left = release - now;
+        if(left < (int) delay) delay = left;
     }
-    return which_dev;
+    if(sleep_next_wakeup(&release)){
+        left = release - now;
+        if(left < (int) delay) delay = left;
+    }
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+    left = mlfq_boost_start + SCHED_MLFQ_BOOST_PERIOD - now;
+    if(left < (int) delay) delay = left;
+#endif
+    // an event already due: fire as soon as possible
+    if((int) delay <= 0) delay = 1;
+    setTIMER(delay);
 }
 
-/* Check if the process which raised an interrupt and was blocked on the
- * corresponding real device semaphore has been killed */
-bool is_process_killed(int which_int){
-    int which_dev = which_device_on_line(which_int);
-    if(which_int==IL_TERMINAL){
-        termreg_t* term = (termreg_t*) DEV_REG_ADDR(IL_TERMINAL,which_dev); 
-        int rec_stat = (char) term->recv_status; // take only the first byte
-        int transm_stat = (char) term->transm_status;
-        if ((transm_stat>1 && headBlocked(&(s_term_array[which_dev][TERM_TRASM]))==NULL)
-                || (rec_stat>1 && headBlocked(&(s_term_array[which_dev][TERM_RECV]))==NULL)){
-            return TRUE;
+/* Put p (which is not in any queue) to sleep for usec microseconds from now.
+ * The sleep queue is sorted by wake up time and each pcb keeps only the time between its
+ * wake up and the one of the previous pcb, so the timer only looks at the expired ones. */
+void sleep_insert(struct pcb_t *p, unsigned int usec){
+    unsigned int now = getTODLO();
+    struct pcb_t* scan;
+    struct pcb_t* tmp;
+    if(dlist_empty(sleep_queue))
+        sleep_base = now;
+    // time from sleep_base to the wake up of p
+    unsigned int delta = (now - sleep_base) + usec;
+    // processes with the same wake up time are kept in FIFO order
+    dlist_foreach(scan, &sleep_queue, p_list, tmp){
+        if(delta < scan->p_sleep_delta){
+            scan->p_sleep_delta -= delta;
+            p->p_sleep_delta = delta;
+            insertProcQBefore(&sleep_queue, p, scan);
+            break;
         }
+        delta -= scan->p_sleep_delta;
     }
-    else if (which_int!=IL_TIMER) {
-        // we don't care about timer interrupts: either its a normal time slice tick 
-        // or its a pseudoclock tick. the former just goes on, while in the latter case
-        // we just free all processes waiting on the pseudoclock
-        if(headBlocked(&(s_dev_array[which_int][which_dev]))==NULL){
-            return TRUE;
+    if(dlist_foreach_all(scan, &sleep_queue, p_list, tmp)){
+        p->p_sleep_delta = delta;
+        insertProcQ(&sleep_queue, p);
+    }
+    p->p_sleeping = TRUE;
+    softblock_count++;
+}
+
+/* Take p out of the sleep queue before its wake up time */
+void sleep_out(struct pcb_t *p){
+    if(!p->p_sleeping)
+        return;
+    // the process after p inherits its delta
+    struct pcb_t* next = dlist_next(p, &sleep_queue, p_list);
+    if(next != NULL)
+        next->p_sleep_delta += p->p_sleep_delta;
+    outProcQ(&sleep_queue, p);
+    p->p_sleeping = FALSE;
+    softblock_count--;
+}
+
+/* Wake up the sleeping processes whose time has come */
+void sleep_wake_due(unsigned int now){
+    struct pcb_t* p;
+    while((p = headProcQ(&sleep_queue)) != NULL && now - sleep_base >= p->p_sleep_delta){
+        removeProcQ(&sleep_queue);
+        sleep_base += p->p_sleep_delta;
+        p->p_sleeping = FALSE;
+        softblock_count--;
+        if(p->p_cursem != NULL){
+            // a timed P: the process gives up the semaphore
+            sem_cancel_wait(p);
+            p->p_s.a1 = SEMOP_TIMEDOUT;
         }
+        ready_insert(p);
     }
-    return FALSE;
 }
 
-/* Manage all devices but terminals */
-void generic_device_handler (int which_int){
+/* Return TRUE and the wake up time of the first sleeping process in when, or FALSE
+ * if nobody is sleeping */
+bool sleep_next_wakeup(unsigned int *when){
+    struct pcb_t* p = headProcQ(&sleep_queue);
+    if(p == NULL)
+        return FALSE;
+    *when = sleep_base + p->p_sleep_delta;
+    return TRUE;
+}
 
-    int which_dev = which_device_on_line(which_int);
-    devreg_t *dev = (devreg_t*)(DEV_REG_ADDR(which_int,which_dev));
+/* Post the completion of an IODEVOPASYNC on the subdevice sub of desc to the process which
+ * issued it, if it is still alive, and wake it up if it is waiting in IOREAP */
+static void async_done(struct dev_desc *desc, int sub, unsigned int status){
+    struct pcb_t* p = pid_lookup(desc->async_pid[sub]);
+    desc->async_pid[sub] = 0;
+    if(p == NULL)
+        // the process has been killed
+        return;
+    struct io_cq* cq = p->p_iocq;
+    // pending <= IO_CQ_SIZE, so there's room for it
+    struct io_completion* c = &(cq->ring[(cq->head + cq->count) % IO_CQ_SIZE]);
+    c->line = desc->line;
+    c->dnum = desc->dev | ((unsigned int) sub << 31);
+    c->status = status;
+    cq->count++;
+    if(cq->waiting){
+        // the buffer of IOREAP is in a2
+        p->p_s.a1 = io_reap(cq, (struct io_completion*) p->p_s.a2);
+        cq->waiting = FALSE;
+        softblock_count--;
+        ready_insert(p);
+    }
+}
 
-    // Verify if there's still a process blocked on that semaphore (could have been killed!)
-    if (!is_process_killed(which_int)){
+/* Pass the status of a completed IODEVOP or IODEVOPASYNC on the subdevice sub of desc to the
+ * process which issued it */
+static void io_done(struct dev_desc *desc, int sub, unsigned int status){
+    if(desc->async_pid[sub] != 0){
+        async_done(desc, sub, status);
+        return;
+    }
+    struct pcb_t* p = pid_lookup(desc->sync_pid[sub]);
+    desc->sync_pid[sub] = 0;
+    if(p != NULL)
         // write into pcb -> a1 device status word
-        headBlocked(&(s_dev_array[which_int][which_dev]))->p_s.a1 = dev->dtp.status;
-        softblock_count--;
+        dev_wake(p, status);
+    // otherwise the process has been killed while waiting, and it already left the semaphore
+}
+
+/* Send the oldest request queued on the subdevice sub of desc, which has just been
+ * acknowledged. The IODEVOPASYNC of the processes which have been killed are dropped
+ * (a killed process takes its IODEVOP out of the queue itself). A request the device doesn't
+ * accept is over at once, with the status IODEVOP returns in that case (no character
+ * transmitted for a TERMWRITE), and the next one is tried */
+static void io_next(struct dev_desc *desc, int sub){
+    struct io_req* req;
+    while((req = clist_head(req, desc->rq[sub], link)) != NULL){
+        clist_dequeue(&(desc->rq[sub]));
+        pid_t pid = req->pid;
+        unsigned int command = req->command;
+        memaddr data0 = req->data0;
+        bool async = req->async;
+        struct buf* buf = req->buf;
+        char* wr_buf = req->wr_buf;
+        unsigned int wr_len = req->wr_len;
+        kmem_free(&ioreq_cache, req);
+        if(buf != NULL){
+            // an operation of the buffer cache
+            desc->buf_op = buf;
+            if(io_start(desc, sub, command) == IO_DONE)
+                return;
+            // it failed without starting
+            bcache_io_done(desc, DEV_BUSY);
+            continue;
+        }
+        struct pcb_t* p = pid_lookup(pid);
+        if(p == NULL)
+            continue;
+        if(async)
+            desc->async_pid[sub] = pid;
+        else {
+            // the process is already waiting on the device semaphore
+            p->p_ioreq = NULL;
+            if(wr_buf != NULL)
+                // a TERMWRITE, its first character is the command
+                term_write_start(desc, wr_buf, wr_len, pid);
+            else
+                desc->sync_pid[sub] = pid;
+        }
+        if(desc->line != IL_TERMINAL)
+            // the buffer of the request, the one in the register may belong to someone else
+            desc->reg->dtp.data0 = data0;
+        unsigned int status;
+        switch(io_start(desc, sub, command)){
+            case IO_DONE:
+                return;
+            case IO_DEV_NOT_INSTALLED:
+                // no interrupt will come for it
+                status = DEV_NOT_INSTALLED;
+                break;
+            default:
+                status = DEV_BUSY;
+                break;
+        }
+        if(wr_buf != NULL){
+            desc->wr.buf = NULL;
+            dev_wake(p, 0);
+        }
+        else
+            io_done(desc, sub, status);
     }
-    // manage our device semaphores
-    sys_semaphoreop(&(s_dev_array[which_int][which_dev]),1);
+}
+
+/* Manage all devices but terminals */
+void generic_device_handler(struct dev_desc *desc){
+    devreg_t *dev = desc->reg;
+    unsigned int status = dev->dtp.status;
+
     // send an ACK to the device
     dev->dtp.command = DEV_C_ACK;
+    if(desc->buf_op != NULL){
+        // a disk operation of the buffer cache: the read or write follows the seek
+        if(bcache_io_done(desc, status))
+            return;
+    }
+    else
+        io_done(desc, TERM_TRASM, status);
+    // and the next request, if any
+    io_next(desc, TERM_TRASM);
+}
+
+/* If a TERMWRITE is in progress on the terminal of desc and its last character was
+ * transmitted, send the next one and return TRUE. Otherwise the write is over (it is
+ * complete, a transmission error occurred or the writer has been killed): return FALSE */
+static bool term_write_next(struct dev_desc *desc, termreg_t *term){
+    struct term_write *wr = &(desc->wr);
+    if(wr->buf == NULL)
+        return FALSE;
+    if((char)term->transm_status != DEV_TTRS_S_CHARTRSM)
+        return FALSE;
+    wr->done++;
+    if(wr->left == 0 || pid_lookup(wr->pid) == NULL)
+        return FALSE;
+    wr->left--;
+    // the new command acknowledges the interrupt too
+    term->transm_command = DEV_TTRS_C_TRSMCHAR | ((unsigned char) *(wr->buf++) << TERM_CHAR_SHIFT);
+    return TRUE;
 }
 
-/* Manage terminal devices */
-void terminal_handler (){
-    int which_dev = which_device_on_line(IL_TERMINAL);
-    termreg_t *term = (termreg_t*)(DEV_REG_ADDR(IL_TERMINAL,which_dev));
-    struct pcb_t* head;
-    // check if there has been an operation on this device
-    // unblock the first completed operation we found, the second one turn will come as soon as 
-    // the interrupt get unmasked again 
+/* Handle a character received by the terminal of desc in buffered mode (see TERMREAD):
+ * it goes to the process waiting for it, if any, otherwise into the ring buffer. The
+ * process is woken up when its buffer is full, after a newline or if an error occurs.
+ * Then the receiver is started again. */
+static void term_read_char(struct dev_desc *desc, termreg_t *term){
+    struct term_read *rd = desc->rd;
+    struct pcb_t *head = headBlocked(desc->sem[TERM_RECV]);
+    unsigned int status = term->recv_status;
+    if((char)status == DEV_TRCV_S_CHARRECV){
+        char c = (char)(status >> TERM_CHAR_SHIFT);
+        if(head != NULL){
+            // the reader keeps its count in a1, its buffer and its size are in a3 and a4
+            ((char*) head->p_s.a3)[head->p_s.a1++] = c;
+            if(c == '\n' || head->p_s.a1 == head->p_s.a4)
+                dev_wake(head, head->p_s.a1);
+        }
+        else if(rd->count < TERM_RING_SIZE){
+            rd->ring[(rd->head + rd->count) % TERM_RING_SIZE] = c;
+            rd->count++;
+        }
+        // characters received while the ring is full are lost
+    }
+    else if(head != NULL){
+        // an error ends the read with the characters received so far
+        dev_wake(head, head->p_s.a1);
+    }
+    // receive the next character, the new command acknowledges the interrupt too
+    term->recv_command = DEV_TRCV_C_RECVCHAR;
+}
+
+/* Manage terminal devices: both a completed write and a completed read on the
+ * same terminal are handled in a single call */
+void terminal_handler(struct dev_desc *desc){
+    termreg_t *term = &(desc->reg->term);
 
     // write has priority over read so we check it first
-    if((char)term->transm_status>1){ // take only the first byte of the register
+    if((char)term->transm_status>1 // take only the first byte of the register
+            && !term_write_next(desc, term)){
         // manage a write operation
-        if(!is_process_killed(IL_TERMINAL)){
-            if( (head = headBlocked(&(s_term_array[which_dev][TERM_TRASM]))) == NULL)
-                PANIC();
-            head->p_s.a1 = term->transm_status;
-            softblock_count--;
+        if(desc->wr.buf != NULL){
+            // the end of a TERMWRITE: its process gets the number of characters transmitted
+            struct pcb_t* writer = pid_lookup(desc->wr.pid);
+            if(writer != NULL)
+                // the writer hasn't been killed
+                dev_wake(writer, desc->wr.done);
+            desc->wr.buf = NULL;
         }
-        sys_semaphoreop(&(s_term_array[which_dev][TERM_TRASM]),1);
+        else
+            io_done(desc, TERM_TRASM, term->transm_status);
         switch ((char)term->transm_status){
             case DEV_TTRS_C_TRSMCHAR:
                 //illegal operation
@@ -303,17 +524,16 @@ void terminal_handler (){
                 term->transm_command = DEV_C_ACK;
                 break;
         }
-        return;
+        // send the next request, if any
+        io_next(desc, TERM_TRASM);
+    }
+    if((char)term->recv_status>1 && desc->rd->active){
+        // a terminal read with TERMREAD
+        term_read_char(desc, term);
     }
-    if((char)term->recv_status>1){ // take only the first byte of the register
+    else if((char)term->recv_status>1){ // take only the first byte of the register
         // manage a read operation
-        if(!is_process_killed(IL_TERMINAL)){
-            if( (head = headBlocked(&(s_term_array[which_dev][TERM_TRASM]))) == NULL)
-                PANIC();
-            head->p_s.a1 = term->recv_status;
-            softblock_count--;
-        }
-        sys_semaphoreop(&(s_term_array[which_dev][TERM_RECV]),1);
+        io_done(desc, TERM_RECV, term->recv_status);
         switch ((char)term->recv_status){
             case DEV_TRCV_C_RECVCHAR:
                 //illegal operation
@@ -331,6 +551,7 @@ void terminal_handler (){
                 term->recv_command = DEV_C_ACK;
                 break;
         }
-        return;
+        // send the next request, if any
+        io_next(desc, TERM_RECV);
     }
 }
@@ -19,11 +19,35 @@
  */
 #include <types.h>
 #include <pcb.h>
-#include <clist.h>
+#include <kmem.h>
+#include <dlist.h>
 
 
 
-static struct clist aslh, semdFree;
+/* The ASL is a hash table: each bucket is an (unsorted) list of the active semaphore
+ * descriptors whose s_semAdd hashes to it, so looking up a semaphore only scans the few
+ * descriptors sharing its bucket instead of the whole list. The buckets are doubly
+ * linked, so a descriptor leaves its bucket in O(1). */
+static struct dlist aslh[ASL_HASH_SIZE];
+/* semaphore descriptors are allocated from this cache, which grows as needed */
+struct kmem_cache semd_cache;
+
+/* Return the bucket of the ASL for the semaphore semAdd. Semaphores are word aligned,
+ * the lowest bits are dropped and some higher ones folded in. */
+static struct dlist *asl_bucket(int *semAdd){
+        unsigned int key = ((unsigned int) semAdd) >> 2;
+        return &aslh[(key ^ (key >> ASL_HASH_BITS)) & (ASL_HASH_SIZE - 1)];
+}
+
+/* Return the descriptor of the semaphore semAdd in its bucket, or NULL if it's not active */
+static struct semd_t *asl_lookup(struct dlist *bucket, int *semAdd){
+        struct semd_t *scan, *tmp;
+        dlist_foreach(scan, bucket, s_link, tmp){
+                if (scan->s_semAdd == semAdd)
+                        return scan;
+        }
+        return NULL;
+}
 
 
 /*****************************************
@@ -34,42 +58,24 @@ static struct clist aslh, semdFree;
  * ciated with the semaphore whose physical address is semAdd and set the
  * semaphore address of p to semAdd. If the semaphore is currently not ac-
  * tive (i.e. there is no descriptor for it in the ASL), allocate a new descriptor
- * from the semdFree list, insert it in the ASL (at the appropriate position),
+ * from the semd cache, insert it in the ASL (in its hash bucket),
  * initialize all of the fields (i.e. set s_semAdd to semAdd, and s_procq), and
  * proceed as above. If a new semaphore descriptor needs to be allocated
- * and the semdFree list is empty, return TRUE. In all other cases return
+ * and there is no memory left for it, return TRUE. In all other cases return
  * FALSE. */
 
 int insertBlocked(int *semAdd, struct pcb_t *p){
-        struct semd_t *scan, *new;
-        void *tmp = NULL;
-        bool found = FALSE;
-        clist_foreach(scan, &aslh, s_link, tmp){
-                if (scan->s_semAdd == semAdd) {
-                        found = TRUE;
-                        break;
-                }
-        }
-        new = scan;
-        /* this could also be if (clist_foreach_all(scan, &aslh, s_link, tmp))
-         * and avoid using bool */
-        if (!found) {
-                /* take first elem from semFree */
-                new = clist_head(new, semdFree, s_link);
-                if (new == NULL) return TRUE; //semFree empty, error
-                clist_dequeue(&semdFree);
+        struct dlist *bucket = asl_bucket(semAdd);
+        struct semd_t *new = asl_lookup(bucket, semAdd);
+        if (new == NULL) {
+                /* take a new descriptor from the cache */
+                new = kmem_alloc(&semd_cache);
+                if (new == NULL) return TRUE; //no more memory, error
                 /* reset its fields */
                 new->s_semAdd = semAdd;
                 new->s_procq.next = NULL;
-                /* add it to ASL */
-                clist_foreach(scan, &aslh, s_link, tmp){
-                        if (new->s_semAdd < scan->s_semAdd){
-                                clist_foreach_add(new, scan, &aslh, s_link, tmp);
-                                break;
-                        }
-                }
-                if (clist_foreach_all(scan, &aslh, s_link, tmp))
-                        clist_enqueue(new, &aslh, s_link);
+                /* add it to its ASL bucket, the order doesn't matter */
+                dlist_push(new, bucket, s_link);
         }
         insertProcQ( &(new->s_procq), p);
         p->p_cursem = new;
@@ -80,30 +86,50 @@ int insertBlocked(int *semAdd, struct pcb_t *p){
  * NULL; otherwise, remove the first (i.e. head) ProcBlk from the process
  * queue of the found semaphore descriptor and return a pointer to it. If the
  * process queue for this semaphore becomes empty remove the semaphore
- * descriptor from the ASL and return it to the semdFree list */
+ * descriptor from the ASL and return it to the semd cache */
 
 struct pcb_t *removeBlocked(int *semAdd){
-        struct pcb_t *head = NULL;
-        struct semd_t *scan;
-        void *tmp = NULL;
-        clist_foreach(scan, &aslh, s_link, tmp){
-                if (scan->s_semAdd == semAdd){
-                        head = removeProcQ( &(scan->s_procq) );
-                        /* head should never be NULL here because if a sem is
-                         * in ASL its s_procq is not empty, but just in case */
-                        if (head != NULL) head->p_cursem = NULL;
-                        if (headProcQ( &(scan->s_procq) ) == NULL){
-                                clist_foreach_delete(scan, &aslh, s_link, tmp);
-                                clist_push(scan, &semdFree, s_link);
-                        }
-                        break;
-                }
+        struct pcb_t *head;
+        struct dlist *bucket = asl_bucket(semAdd);
+        struct semd_t *semd = asl_lookup(bucket, semAdd);
+        if (semd == NULL)
+                return NULL;
+        head = removeProcQ( &(semd->s_procq) );
+        /* head should never be NULL here because if a sem is
+         * in ASL its s_procq is not empty, but just in case */
+        if (head != NULL) head->p_cursem = NULL;
+        if (headProcQ( &(semd->s_procq) ) == NULL){
+                dlist_delete(semd, bucket, s_link);
+                kmem_free(&semd_cache, semd);
         }
-        /* no need to check if the for loop finished without finding semAdd,
-         * because if it did so, the head is already NULL */
         return head;
 }
 
+/* Search the ASL for a descriptor of this semaphore. If none is found, return
+ * 0; otherwise, move its whole process queue, in order, to the tail of the
+ * process queue q, remove the semaphore descriptor from the ASL and return
+ * it to the semd cache. The queue is moved in constant time, only the
+ * semaphore address and the queue of the moved ProcBlks are reset one by
+ * one. Return the number of ProcBlks moved */
+
+int removeAllBlocked(int *semAdd, struct dlist *q){
+        int count = 0;
+        struct pcb_t *scan, *tmp;
+        struct dlist *bucket = asl_bucket(semAdd);
+        struct semd_t *semd = asl_lookup(bucket, semAdd);
+        if (semd == NULL)
+                return 0;
+        dlist_foreach(scan, &(semd->s_procq), p_list, tmp){
+                scan->p_cursem = NULL;
+                scan->p_queue = q;
+                count++;
+        }
+        dlist_splice(&(semd->s_procq), q);
+        dlist_delete(semd, bucket, s_link);
+        kmem_free(&semd_cache, semd);
+        return count;
+}
+
 /* Remove the ProcBlk pointed to by p from the process queue associated
  * with p's semaphore on the ASL. If ProcBlk pointed to by p does not
  * appear in the process queue associated with p's semaphore, which is an
@@ -114,35 +140,27 @@ struct pcb_t *removeBlocked(int *semAdd){
  * the last blocked pcb_t. 
  * We decided to have this function behave like removeBlocked does: it will remove 
  * semaphore descriptors with an empty process queue from the ASL and return it to
- * the semdFree list. 
+ * the semd cache.
  * Not doing so could eventually result in an empty semaphore in the A(ctive)SL and 
  * we would like to avoid that.
  * If outBlocked is not supposed to behave like this for some phase 2 reason we 
  * will modify it accordingly. */
 
 struct pcb_t *outBlocked(struct pcb_t *p){
-        struct pcb_t *ret = p;
-        struct semd_t *scan;
-        void *tmp = NULL;
-        bool found = FALSE;
-        clist_foreach(scan, &aslh, s_link, tmp){
-                if (scan == p->p_cursem){
-                        found = TRUE;
-                        ret = outProcQ( &(scan->s_procq), p);
-                        /* p->p_cursem is reset anyway */
-                        p->p_cursem = NULL;
-                        /* p might have been the only element in scan->s_procq
-                         * if so we should free it */
-                        if (headProcQ( &(scan->s_procq) ) == NULL){
-                                clist_foreach_delete(scan, &aslh, s_link, tmp);
-                                clist_push(scan, &semdFree, s_link);
-                        }
-                        break;
-                }
-        }
-        /* if p cursem is not in the ASL (should never happen) */
-        if (!found)
+        struct pcb_t *ret;
+        struct semd_t *semd = p->p_cursem;
+        /* if p is not blocked on any semaphore (should never happen) */
+        if (semd == NULL)
                 return NULL;
+        ret = outProcQ( &(semd->s_procq), p);
+        /* p->p_cursem is reset anyway */
+        p->p_cursem = NULL;
+        /* p might have been the only element in semd->s_procq
+         * if so we should free it */
+        if (headProcQ( &(semd->s_procq) ) == NULL){
+                dlist_delete(semd, asl_bucket(semd->s_semAdd), s_link);
+                kmem_free(&semd_cache, semd);
+        }
         /* ret is NULL if p was not in its cursem procq */
         return ret;
 }
@@ -152,24 +170,18 @@ struct pcb_t *outBlocked(struct pcb_t *p){
  * found on the ASL or if the process queue associated with semAdd is empty */
 
 struct pcb_t *headBlocked(int *semAdd){
-        struct pcb_t *head = NULL;
-        struct semd_t *scan;
-        void *tmp = NULL;
-        clist_foreach(scan, &aslh, s_link, tmp){
-                if (scan->s_semAdd == semAdd){
-                        head = headProcQ( &(scan->s_procq) );
-                        break;
-                }
-        }
-        return head;
+        struct semd_t *semd = asl_lookup(asl_bucket(semAdd), semAdd);
+        if (semd == NULL)
+                return NULL;
+        return headProcQ( &(semd->s_procq) );
 }
 
-/* Initialize the semdFree list to contain all the elements of the array */
+/* Initialize the semaphore descriptor cache and the ASL */
 
 void initASL(void){
-        static struct semd_t semdTable[MAXPROC]; //visible only here, accessible outside with poiters
-        int i = 0;
-        for(i;i<MAXPROC;i++){
-                clist_push(&semdTable[i], &semdFree, s_link);
+        int i;
+        kmem_cache_init(&semd_cache, sizeof(struct semd_t));
+        for(i=0;i<ASL_HASH_SIZE;i++){
+                aslh[i].next = NULL;
         }
 }
@@ -21,23 +21,129 @@
 #include <types.h>
 
 /* our implementation of the memset function offered by string.h
- * sets the object pointed by s to the value of c, byte by byte. */
+ * sets the object pointed by s to the value of c. The bytes up to the first word boundary
+ * are set one by one, then whole words are stored (eight at a time with a single stm on
+ * arm), then the remaining tail bytes one by one. */
 
 void* mymemset(void* s, int c, size_t n) {
     unsigned char* p = (unsigned char*)s;
     // consider only the first byte of c if its larger than one byte (it shouldn't be)
     unsigned char tmp = c & 0xff;
+    while (n > 0 && ((size_t) p & 3)) {
+        *p++ = tmp;
+        n--;
+    }
+    if (n >= 4) {
+        unsigned int word = tmp * 0x01010101U;
+        unsigned int* w = (unsigned int*)p;
+#ifdef __arm__
+        if (n >= 32) {
+            register unsigned int r3 asm("r3") = word;
+            register unsigned int r4 asm("r4") = word;
+            register unsigned int r5 asm("r5") = word;
+            register unsigned int r6 asm("r6") = word;
+            register unsigned int r7 asm("r7") = word;
+            register unsigned int r8 asm("r8") = word;
+            register unsigned int r9 asm("r9") = word;
+            register unsigned int r10 asm("r10") = word;
+            do {
+                __asm__ volatile("stmia %0!, {r3-r10}"
+                        : "+r" (w)
+                        : "r" (r3), "r" (r4), "r" (r5), "r" (r6),
+                          "r" (r7), "r" (r8), "r" (r9), "r" (r10)
+                        : "memory");
+                n -= 32;
+            } while (n >= 32);
+        }
+#else
+        while (n >= 32) {
+            w[0] = word; w[1] = word; w[2] = word; w[3] = word;
+            w[4] = word; w[5] = word; w[6] = word; w[7] = word;
+            w += 8;
+            n -= 32;
+        }
+#endif
+        while (n >= 4) {
+            *w++ = word;
+            n -= 4;
+        }
+        p = (unsigned char*)w;
+    }
     while (n--)
         *p++ = tmp;
     return s;
 }
 
 /* our implementation of the memcpy function offered by string.h
- * copies n bytes from the object pointed by "from" to the object pointed by "to", byte by byte. */
+ * copies n bytes from the object pointed by "from" to the object pointed by "to".
+ * If both have the same alignment whole words are moved (eight at a time with ldm/stm on
+ * arm) between the byte by byte head and tail, otherwise it goes byte by byte. */
 
 void mymemcopy(void* from, void* to, size_t n){
     char *cfrom = (char *)from;
     char *cto = (char *)to;
-    for (int i=0; i<n; i++)
-        cto[i] = cfrom[i];
+    if ((((size_t) cfrom ^ (size_t) cto) & 3) == 0) {
+        while (n > 0 && ((size_t) cfrom & 3)) {
+            *cto++ = *cfrom++;
+            n--;
+        }
+        unsigned int *wfrom = (unsigned int *)cfrom;
+        unsigned int *wto = (unsigned int *)cto;
+#ifdef __arm__
+        while (n >= 32) {
+            __asm__ volatile("ldmia %0!, {r3-r10}\n\t"
+                             "stmia %1!, {r3-r10}"
+                    : "+r" (wfrom), "+r" (wto)
+                    :
+                    : "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "memory");
+            n -= 32;
+        }
+#else
+        while (n >= 32) {
+            wto[0] = wfrom[0]; wto[1] = wfrom[1]; wto[2] = wfrom[2]; wto[3] = wfrom[3];
+            wto[4] = wfrom[4]; wto[5] = wfrom[5]; wto[6] = wfrom[6]; wto[7] = wfrom[7];
+            wfrom += 8;
+            wto += 8;
+            n -= 32;
+        }
+#endif
+        while (n >= 4) {
+            *wto++ = *wfrom++;
+            n -= 4;
+        }
+        cfrom = (char *)wfrom;
+        cto = (char *)wto;
+    }
+    while (n--)
+        *cto++ = *cfrom++;
+}
+
+/* index of the most significant set bit of x (x must not be 0).
+ * The arm7tdmi has no clz instruction, so we smear the highest bit to the right and
+ * look it up in a de Bruijn table: one multiply and one load, whatever the value of x. */
+
+static const unsigned char debruijn_msb[32] = {
+    0, 9, 1, 10, 13, 21, 2, 29, 11, 14, 16, 18, 22, 25, 3, 30,
+    8, 12, 20, 28, 15, 17, 24, 7, 19, 27, 23, 6, 26, 5, 4, 31
+};
+
+int highest_bit(unsigned int x){
+    x |= x >> 1;
+    x |= x >> 2;
+    x |= x >> 4;
+    x |= x >> 8;
+    x |= x >> 16;
+    return debruijn_msb[(x * 0x07C4ACDDU) >> 27];
+}
+
+/* index of the least significant set bit of x (x must not be 0).
+ * x & -x isolates the lowest bit, so the multiply by the de Bruijn constant is just a shift. */
+
+static const unsigned char debruijn_lsb[32] = {
+    0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+    31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+};
+
+int lowest_bit(unsigned int x){
+    return debruijn_lsb[((x & -x) * 0x077CB531U) >> 27];
 }
@@ -0,0 +1,133 @@
+/* Kernel memory allocator
+ *
+ * A didactic simulation of an arm OS running on the uarm emulator.
+ * Copyright (C) 2016 Carlo De Pieri, Alessio Koci, Gianmaria Pedrini,
+ * Alessio Trivisonno
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <const.h>
+#include <types.h>
+#include <kmem.h>
+#include <libuarm.h>
+#include <arch.h>
+
+/* end of the kernel image (data and bss), defined by the linker */
+extern char _end;
+
+/* first free page, and the limit of the pages the kernel can use */
+static memaddr kmem_brk = 0, kmem_limit = 0;
+
+/* A free object in a cache: its first word links it to the next free one */
+struct kmem_free_obj {
+        struct kmem_free_obj *next;
+};
+
+
+/*****************************************
+ * Kernel Memory Allocation              *
+ *****************************************/
+
+/* Set the limits of the free RAM the first time they're needed: it starts at the first page
+ * after the kernel image and ends below the stacks */
+static void kmem_set_limits(void){
+        if (kmem_brk == 0) {
+                kmem_brk = ((memaddr) &_end + KMEM_PAGE_SIZE - 1) & ~(KMEM_PAGE_SIZE - 1);
+                kmem_limit = RAM_TOP - KMEM_STACK_RESERVE;
+        }
+}
+
+/* Return a new page of KMEM_PAGE_SIZE bytes, or NULL if the free RAM is over */
+void *kmem_page_alloc(void){
+        kmem_set_limits();
+        if (kmem_brk >= kmem_limit || kmem_limit - kmem_brk < KMEM_PAGE_SIZE)
+                return NULL;
+        void *page = (void *) kmem_brk;
+        kmem_brk += KMEM_PAGE_SIZE;
+        return page;
+}
+
+/* Return the number of pages which can still be allocated */
+unsigned int kmem_pages_free(void){
+        kmem_set_limits();
+        if (kmem_brk >= kmem_limit)
+                return 0;
+        return (kmem_limit - kmem_brk) / KMEM_PAGE_SIZE;
+}
+
+/* Initialize an empty cache of objects of obj_size bytes (at most KMEM_PAGE_SIZE) */
+void kmem_cache_init(struct kmem_cache *cache, size_t obj_size){
+        /* objects are word aligned and big enough to link the free ones */
+        obj_size = (obj_size + sizeof(memaddr) - 1) & ~(sizeof(memaddr) - 1);
+        if (obj_size < sizeof(struct kmem_free_obj))
+                obj_size = sizeof(struct kmem_free_obj);
+        cache->obj_size = obj_size;
+        cache->slab_objs = KMEM_PAGE_SIZE / obj_size;
+        cache->free = NULL;
+        cache->total = 0;
+        cache->in_use = 0;
+        cache->slabs = 0;
+}
+
+/* Grow the cache by a slab: split a new page into free objects.
+ * Return FALSE if the free RAM is over */
+static bool kmem_cache_grow(struct kmem_cache *cache){
+        char *slab = kmem_page_alloc();
+        unsigned int i;
+        if (slab == NULL) return FALSE;
+        for (i = 0; i < cache->slab_objs; i++)
+                kmem_free(cache, slab + i * cache->obj_size);
+        /* kmem_free counted them as objects in use given back */
+        cache->in_use += cache->slab_objs;
+        cache->total += cache->slab_objs;
+        cache->slabs++;
+        return TRUE;
+}
+
+/* Return a free object of the cache, growing it by a slab if needed.
+ * Return NULL if the cache is empty and the free RAM is over */
+void *kmem_alloc(struct kmem_cache *cache){
+        struct kmem_free_obj *obj;
+        if (cache->free == NULL && !kmem_cache_grow(cache))
+                return NULL;
+        obj = cache->free;
+        cache->free = obj->next;
+        cache->in_use++;
+        return obj;
+}
+
+/* Grow the cache until it has n objects, free or in use: since slabs are never given back,
+ * n objects can be allocated from then on. Return FALSE if the free RAM is over */
+bool kmem_cache_reserve(struct kmem_cache *cache, unsigned int n){
+        while (cache->total < n) {
+                if (!kmem_cache_grow(cache)) return FALSE;
+        }
+        return TRUE;
+}
+
+/* Give back an object to its cache */
+void kmem_free(struct kmem_cache *cache, void *obj){
+        struct kmem_free_obj *free = obj;
+        free->next = cache->free;
+        cache->free = free;
+        cache->in_use--;
+}
+
+/* Fill stats with the usage of the cache */
+void kmem_cache_stats(struct kmem_cache *cache, struct kmem_stats *stats){
+        stats->obj_size = cache->obj_size;
+        stats->total = cache->total;
+        stats->in_use = cache->in_use;
+        stats->slabs = cache->slabs;
+}
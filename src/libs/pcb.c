@@ -20,41 +20,93 @@
 #include <const.h>
 #include <types.h>
 #include <helplib.h>
+#include <kmem.h>
 #include <libuarm.h>
 
 #include <clist.h>
+#include <dlist.h>
 
 
 /************************************************
  * The Allocation and Deallocation of ProcBlk's *
  ************************************************/
 
-static struct clist pcbFree=CLIST_INIT;
+/* pcbs, their exception handler extensions and their I/O completion queues are
+ * allocated from these caches, which grow as needed */
+struct kmem_cache pcb_cache;
+struct kmem_cache excp_cache;
+struct kmem_cache iocq_cache;
 
-/*insert the element pointed to by p onto the pcbFree list*/
+/*give back the element pointed to by p (and its extensions) to the pcb cache*/
 void freePcb(struct pcb_t *p){
-        clist_push(p, &pcbFree, p_list)
+        if (p->p_excp != NULL) kmem_free(&excp_cache, p->p_excp);
+        if (p->p_iocq != NULL) kmem_free(&iocq_cache, p->p_iocq);
+        kmem_free(&pcb_cache, p);
 }
 
-/*return an element from the freePcb list*/
+/*return a new pcb, NULL if there's no more memory for it*/
 struct pcb_t *allocPcb(){
-        if (clist_empty(pcbFree)) return NULL;
-        else {
-                struct pcb_t *newPcb;
-                newPcb = clist_head(newPcb, pcbFree, p_list);
-                clist_pop(&pcbFree);
-                mymemset(newPcb, 0, sizeof(struct pcb_t));
-                return newPcb;
-        }
+        struct pcb_t *newPcb = kmem_alloc(&pcb_cache);
+        if (newPcb == NULL) return NULL;
+        mymemset(newPcb, 0, sizeof(struct pcb_t));
+        return newPcb;
+}
+
+/*attach a new, empty exception handler extension to p and return it, NULL if there's
+ *no more memory for it*/
+struct pcb_excp_t *allocExcp(struct pcb_t *p){
+        struct pcb_excp_t *excp = kmem_alloc(&excp_cache);
+        if (excp == NULL) return NULL;
+        mymemset(excp, 0, sizeof(struct pcb_excp_t));
+        p->p_excp = excp;
+        return excp;
 }
 
-/*allocate pcbs and fill freePcb - run once*/
+/*attach a new, empty I/O completion queue to p and return it, NULL if there's no more
+ *memory for it*/
+struct io_cq *allocIocq(struct pcb_t *p){
+        struct io_cq *iocq = kmem_alloc(&iocq_cache);
+        if (iocq == NULL) return NULL;
+        mymemset(iocq, 0, sizeof(struct io_cq));
+        p->p_iocq = iocq;
+        return iocq;
+}
+
+/*return a new pcb like allocPcb, but without clearing it all: only the links, the counters
+ *and the fields the kernel reads before writing them are initialized. The processor state,
+ *the pid and the scheduling parameters (p_prio, p_base_prio, p_quantum, p_tickets, p_pass)
+ *are left to the caller, the real time and sleep fields are set when the process enters
+ *those states, and the extensions are attached only when needed.
+ *NULL if there's no more memory*/
+struct pcb_t *allocPcbLazy(){
+        struct pcb_t *newPcb = kmem_alloc(&pcb_cache);
+        if (newPcb == NULL) return NULL;
+        newPcb->p_parent = NULL;
+        newPcb->p_cursem = NULL;
+        newPcb->p_excp = NULL;
+        newPcb->sys_time = 0;
+        newPcb->usr_time = 0;
+        newPcb->s_req_weight = 0;
+        newPcb->p_level_start = 0;
+        newPcb->p_run_start = 0;
+        newPcb->p_rt_period = 0;
+        newPcb->p_rt_waiting = FALSE;
+        newPcb->p_sleeping = FALSE;
+        newPcb->p_semv_held = NULL;
+        newPcb->p_iocq = NULL;
+        newPcb->p_ioreq = NULL;
+        newPcb->p_list.next = NULL;
+        newPcb->p_queue = NULL;
+        newPcb->p_children.next = NULL;
+        newPcb->p_siblings.next = NULL;
+        return newPcb;
+}
+
+/*initialize the pcb caches - run once*/
 void initPcbs(void){
-        static struct pcb_t pcbArray[MAXPROC]; //visible only here, accessible outside with poiters
-        int i = 0;
-        for(i;i<MAXPROC;i++){
-                clist_push(&pcbArray[i], &pcbFree, p_list);
-        }
+        kmem_cache_init(&pcb_cache, sizeof(struct pcb_t));
+        kmem_cache_init(&excp_cache, sizeof(struct pcb_excp_t));
+        kmem_cache_init(&iocq_cache, sizeof(struct io_cq));
 }
 
 
@@ -64,21 +116,30 @@ void initPcbs(void){
 
 /*Insert the ProcBlk pointed to by p into the process queue whose list-tail*/
 /*pointer is q.*/
-void insertProcQ(struct clist *q, struct pcb_t *p){
+void insertProcQ(struct dlist *q, struct pcb_t *p){
+
+        dlist_enqueue(p, q, p_list);
+        p->p_queue = q;
+}
+
+/*Insert the ProcBlk pointed to by p into the process queue whose list-tail*/
+/*pointer is q, just before the ProcBlk pointed to by next, which is in q.*/
+void insertProcQBefore(struct dlist *q, struct pcb_t *p, struct pcb_t *next){
 
-        clist_enqueue(p, q, p_list);
+        dlist_foreach_add(p, next, q, p_list, next);
+        p->p_queue = q;
 }
 
 /*Remove the first (i.e. head) element from the process queue whose list-*/
 /*tail pointer is q. Return NULL if the process queue was initially empty;*/
 /*otherwise return the pointer to the removed element.*/
-struct pcb_t *removeProcQ(struct clist *q){
+struct pcb_t *removeProcQ(struct dlist *q){
 
-        if (clist_empty(*q)) return NULL;
+        if (dlist_empty(*q)) return NULL;
         else {
-                struct pcb_t *head = clist_head(head, *q, p_list);
-                clist_dequeue(q);
-                head->p_list.next = NULL;
+                struct pcb_t *head = dlist_head(head, *q, p_list);
+                dlist_dequeue(q);
+                head->p_queue = NULL;
                 return head;
         }
 }
@@ -87,12 +148,14 @@ struct pcb_t *removeProcQ(struct clist *q){
 /*pointer is q. If the desired entry is not in the indicated queue (an error*/
 /*condition), return NULL; otherwise, return p. Note that p can point to*/
 /*any element of the process queue.*/
-struct pcb_t *outProcQ(struct clist *q, struct pcb_t *p){
+/*The unlink is O(1): every ProcBlk records the queue it is in.*/
+struct pcb_t *outProcQ(struct dlist *q, struct pcb_t *p){
 
-        if (clist_delete(p, q, p_list) == 1) 
-                return NULL; 
+        if (p->p_queue != q)
+                return NULL;
         else {
-                p->p_list.next = NULL;
+                dlist_delete(p, q, p_list);
+                p->p_queue = NULL;
                 return p;
         }
 
@@ -101,8 +164,8 @@ struct pcb_t *outProcQ(struct clist *q, struct pcb_t *p){
 /*Return a pointer to the first ProcBlk from the process queue whose list-*/
 /*tail pointer is q. Do not remove this ProcBlk from the process queue.*/
 /*Return NULL if the process queue is empty.*/
-struct pcb_t *headProcQ(struct clist *q){
-        struct pcb_t *head = clist_head(head, *q, p_list);
+struct pcb_t *headProcQ(struct dlist *q){
+        struct pcb_t *head = dlist_head(head, *q, p_list);
         return head;
 }
 
@@ -113,12 +176,12 @@ struct pcb_t *headProcQ(struct clist *q){
 
 /* Return TRUE if the ProcBlk pointed to by p has no children. Return FALSE otherwise */
 int emptyChild(struct pcb_t *p){
-        return clist_empty(p->p_children);
+        return dlist_empty(p->p_children);
 }
 
 /* Make the ProcBlk pointed to by p a child of the ProcBlk pointed to by parent */
 void insertChild(struct pcb_t *parent, struct pcb_t *p){
-        clist_push(p, &(parent->p_children), p_siblings);
+        dlist_push(p, &(parent->p_children), p_siblings);
         p->p_parent = parent;
 }
 
@@ -128,8 +191,8 @@ void insertChild(struct pcb_t *parent, struct pcb_t *p){
 struct pcb_t *removeChild(struct pcb_t *p){
         if (emptyChild(p)) return NULL;
         else {
-                struct pcb_t *child = clist_head(p, p->p_children, p_siblings);
-                clist_pop(&(p->p_children));
+                struct pcb_t *child = dlist_head(p, p->p_children, p_siblings);
+                dlist_pop(&(p->p_children));
                 /* doesnt need to search for it since its always the first element */
                 child->p_parent = NULL;
                 return child;
@@ -143,7 +206,7 @@ struct pcb_t *outChild(struct pcb_t *p){
         if ( !(p->p_parent) ) return NULL;
         else {
                 struct pcb_t *parent = p->p_parent;
-                clist_delete(p, &(parent->p_children), p_siblings);
+                dlist_delete(p, &(parent->p_children), p_siblings);
                 p->p_parent = NULL;
                 return p;
         }
@@ -24,8 +24,11 @@
 // phase 1 libs
 #include <pcb.h>
 #include <clist.h>
+#include <dlist.h>
+#include <helplib.h>
 // phase 2 libs
 #include <scheduler.h>
+#include <interrupts.h>
 // uARM libs
 #include <libuarm.h>
 
@@ -33,30 +36,53 @@
 #include <debug.h>
 #endif
 
-// these two int are usefull to decide how much time to set the timer to
-int next_time_slice;
-int curr_proc_time_left;
+// timestamp of the end of the time slice of curr_proc
+unsigned int slice_end;
 // this indicates if we're in a wait processor pattern
 bool nearwait = FALSE;
-extern struct clist* ready_queue;
+extern struct dlist ready_queues[SCHED_PRIO_LEVELS];
+extern unsigned int ready_bitmap;
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+// pass of the last dispatched process: processes waking up can't be behind it
+unsigned int stride_vtime = 0;
+#endif
+// ready real time processes, sorted by deadline
+static struct dlist rt_ready_queue = DLIST_INIT;
+// real time processes waiting for the release of their next job, sorted by release time
+static struct dlist rt_release_queue = DLIST_INIT;
+// overall utilization of the real time processes, per mille
+static unsigned int rt_util = 0;
 extern int proc_count;
 extern int softblock_count;
 extern struct pcb_t* curr_proc;
 
 /* Main scheduler function. It's argument its used to take different action based on where the
  * scheduler is called from.
- * This is a simple round robin scheduler. */
+ * Real time processes run first, earliest deadline first. Then this is a strict priority
+ * scheduler: the highest priority ready process always runs, processes with the same
+ * priority are scheduled round robin (or by stride, see const.h). */
 void schedule (int state){
     if(state==SCHED_TIME_SLICE_ENDED){
-        // time slice for the curr_proc has endend, we must move it to the ready_queue
+        // time slice for the curr_proc has endend, we must move it to the ready queue
         // first copy the process' processor state from INT_OLDAREA
         curr_proc->p_s = *((state_t*) INT_OLDAREA);
-        // enquee the curr_proc into ready_queue 
-        insertProcQ(ready_queue, curr_proc);
+        // let the policy adjust the process priority
+        sched_slice_ended(curr_proc);
+        if(IS_RT(curr_proc) && curr_proc->p_rt_budget_left <= 0)
+            // the job used up its budget, it will go on in the next period
+            rt_wait_next_period(curr_proc);
+        else
+            // enquee the curr_proc into its ready queue
+            ready_insert(curr_proc);
+    }
+    else if(state==SCHED_PROC_PREEMPTED){
+        // the caller already saved the processor state of curr_proc
+        sched_preempted(curr_proc);
+        ready_insert(curr_proc);
     }
 
-    //ready_queue is empty
-    if(clist_empty(*ready_queue)){
+    //ready queues are empty
+    if(ready_empty()){
         
         if(proc_count == 0){
             // no process to execute
@@ -70,6 +96,8 @@ void schedule (int state){
             // process waiting an interrupt 
             // this flag will let the interrupt handler know that we are approaching a waiting state
             nearwait = TRUE;
+            // only the pseudo clock (or nothing at all) needs the timer now
+            set_next_timer(FALSE);
             // enable normal interrupt
             setSTATUS(STATUS_ALL_INT_ENABLE(getSTATUS()));
             WAIT();
@@ -78,33 +106,311 @@ void schedule (int state){
 
     }
 
-    // set the curr_proc to the first ready pcb_t and remove head from ready_queue 
-    curr_proc = removeProcQ(ready_queue);
+    // set the curr_proc to the earliest deadline real time process or to the first pcb_t of
+    // the highest priority ready queue
+    curr_proc = ready_remove();
     if(curr_proc == NULL)
         // should never happen
         PANIC();
     curr_proc->user_enter_timestamp = getTODLO();
-    if(state == SCHED_INIT){
-        curr_proc_time_left = 0;
-        setTIMER(SCHED_TIME_SLICE);
-    }
-    else if(state==SCHED_PROC_KILLED || state == SCHED_PROC_BLOCKED || state == SCHED_NEARWAIT){
-        extern int pseudo_clock_start;
-        int pseudoclock = getTODLO()-pseudo_clock_start;
-        int time = SCHED_TIME_SLICE;
-        // be sure to reset curr_proc_time_left if the process had a splitted time slice
-        curr_proc_time_left = 0;
-        if(pseudoclock>(SCHED_PSEUDO_CLOCK-SCHED_TIME_SLICE) && pseudoclock< SCHED_PSEUDO_CLOCK){
-            // This process got killed between 95ms and 100ms. We want the next interrupt to come near
-            // the pseudo clock tick
-            time = SCHED_PSEUDO_CLOCK - pseudoclock;
-            curr_proc_time_left = SCHED_TIME_SLICE - time;
-        }
-        setTIMER(time);
+    curr_proc->p_run_start = curr_proc->usr_time + curr_proc->sys_time;
+    if(IS_RT(curr_proc)){
+        // a real time job can run until it uses up its budget
+        slice_end = curr_proc->user_enter_timestamp +
+            (curr_proc->p_rt_budget_left > 0 ? curr_proc->p_rt_budget_left : 0);
     }
-    else if(state == SCHED_TIME_SLICE_ENDED){
-            setTIMER(next_time_slice);
+    else {
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+        stride_vtime = curr_proc->p_pass;
+#endif
+        // the process gets a whole new time slice, the timer is set for it only if someone
+        // else is ready to run
+        slice_end = curr_proc->user_enter_timestamp + curr_proc->p_quantum;
     }
+    set_next_timer(TRUE);
     // load the pcb_t processor state into the processor
     LDST((void*) &curr_proc->p_s);
 }
+
+/* Insert p into the process queue q, kept sorted by the unsigned int field of pcb_t at the
+ * offset key. Keys are compared as timestamps, so they can wrap around; processes with the
+ * same key are kept in FIFO order. */
+static void insert_sorted(struct dlist *q, struct pcb_t *p, size_t key){
+    struct pcb_t* scan;
+    struct pcb_t* tmp;
+    unsigned int p_key = *((unsigned int*) ((char*) p + key));
+    dlist_foreach(scan, q, p_list, tmp){
+        if((int)(p_key - *((unsigned int*) ((char*) scan + key))) < 0){
+            insertProcQBefore(q, p, scan);
+            break;
+        }
+    }
+    if(dlist_foreach_all(scan, q, p_list, tmp))
+        insertProcQ(q, p);
+}
+
+/* Insert a pcb at the tail of the ready queue of its priority.
+ * With stride scheduling the queue is kept sorted by pass instead.
+ * Real time processes go into their own queue, sorted by deadline. */
+void ready_insert(struct pcb_t *p){
+    if(IS_RT(p)){
+        insert_sorted(&rt_ready_queue, p, offsetof(struct pcb_t, p_rt_deadline));
+        return;
+    }
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+    // a process which was blocked doesn't get the CPU time it missed in the meantime
+    if((int)(p->p_pass - stride_vtime) < 0)
+        p->p_pass = stride_vtime;
+    insert_sorted(&(ready_queues[p->p_prio]), p, offsetof(struct pcb_t, p_pass));
+#else
+    insertProcQ(&(ready_queues[p->p_prio]), p);
+#endif
+    ready_bitmap |= 1 << p->p_prio;
+}
+
+/* Remove and return the earliest deadline real time process, or else the head of the
+ * highest priority non empty ready queue. Return NULL if there's no ready process. */
+struct pcb_t* ready_remove(){
+    if(!dlist_empty(rt_ready_queue))
+        return removeProcQ(&rt_ready_queue);
+    if(ready_bitmap == 0)
+        return NULL;
+    // the highest set bit in the bitmap is the highest priority with a ready process
+    int prio = highest_bit(ready_bitmap);
+    struct pcb_t* p = removeProcQ(&(ready_queues[prio]));
+    if(dlist_empty(ready_queues[prio]))
+        ready_bitmap &= ~(1 << prio);
+    return p;
+}
+
+/* Remove the given pcb from its ready queue. Return NULL if it was not there. */
+struct pcb_t* ready_out(struct pcb_t *p){
+    if(IS_RT(p))
+        return outProcQ(&rt_ready_queue, p);
+    struct pcb_t* ret = outProcQ(&(ready_queues[p->p_prio]), p);
+    if(dlist_empty(ready_queues[p->p_prio]))
+        ready_bitmap &= ~(1 << p->p_prio);
+    return ret;
+}
+
+/* Return TRUE if there's no ready process */
+bool ready_empty(){
+    return ready_bitmap == 0 && dlist_empty(rt_ready_queue);
+}
+
+/* Policy hook, called when the time slice of p has ended. With MLFQ p is demoted.
+ * For real time processes this means that the job used up its budget. */
+void sched_slice_ended(struct pcb_t *p){
+    if(IS_RT(p)){
+        rt_charge(p);
+        return;
+    }
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+    // the process used up its whole time slice, it is CPU bound
+    mlfq_set_level(p, p->p_prio - 1);
+#elif SCHED_POLICY == SCHED_POLICY_STRIDE
+    stride_charge(p);
+#endif
+}
+
+/* Policy hook, called when p has been preempted by a higher priority process. */
+void sched_preempted(struct pcb_t *p){
+    if(IS_RT(p)){
+        rt_charge(p);
+        return;
+    }
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+    stride_charge(p);
+#endif
+}
+
+/* Policy hook, called when p is about to block. on_io is TRUE if p is blocking on a device
+ * or on the pseudo clock. With MLFQ p is boosted if it's waiting for I/O, otherwise it's
+ * demoted if it used up its time allotment. */
+void sched_blocked(struct pcb_t *p, bool on_io){
+    if(IS_RT(p)){
+        rt_charge(p);
+        return;
+    }
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+    if(on_io)
+        mlfq_set_level(p, p->p_prio + 1);
+    // the usr_time/sys_time accounting is up to date here, since the syscall handler
+    // updated it: blocking on a semaphore doesn't save a process from demotion
+    else if((p->usr_time + p->sys_time) - p->p_level_start >= p->p_quantum)
+        mlfq_set_level(p, p->p_prio - 1);
+#elif SCHED_POLICY == SCHED_POLICY_STRIDE
+    stride_charge(p);
+#endif
+}
+
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+/* Advance the pass of a process which is leaving the CPU by its stride for each
+ * SCHED_STRIDE_UNIT of cpu time it used since its dispatch (rounded up, so a process
+ * can't run for free by blocking early). */
+void stride_charge(struct pcb_t *p){
+    cputime_t used = (p->usr_time + p->sys_time) - p->p_run_start;
+    p->p_pass += (SCHED_STRIDE1 / p->p_tickets) * ((used + SCHED_STRIDE_UNIT - 1) / SCHED_STRIDE_UNIT);
+}
+#endif
+
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+/* Move a process which is not in a ready queue to the given MLFQ level, bounded by
+ * SCHED_PRIO_MIN and its base priority. Its time allotment starts again. */
+void mlfq_set_level(struct pcb_t *p, int level){
+    if(level > p->p_base_prio)
+        level = p->p_base_prio;
+    if(level < SCHED_PRIO_MIN)
+        level = SCHED_PRIO_MIN;
+    p->p_prio = level;
+    p->p_level_start = p->usr_time + p->sys_time;
+}
+
+/* Anti starvation boost: every ready process (and curr_proc) gets back to its base
+ * priority, so CPU bound processes demoted to the lowest levels can't starve forever. */
+void mlfq_boost(){
+    // the top level holds only processes which are already at their base priority
+    for(int prio = SCHED_PRIO_MIN; prio < SCHED_PRIO_MAX; prio++){
+        struct dlist tmp = DLIST_INIT;
+        struct pcb_t* p;
+        // empty the queue first, since a process could be reinserted into it
+        while((p = removeProcQ(&(ready_queues[prio]))) != NULL)
+            insertProcQ(&tmp, p);
+        ready_bitmap &= ~(1 << prio);
+        while((p = removeProcQ(&tmp)) != NULL){
+            mlfq_set_level(p, p->p_base_prio);
+            ready_insert(p);
+        }
+    }
+    // in nearwait state curr_proc is the last process which ran, not a running one
+    if(curr_proc != NULL && !nearwait)
+        mlfq_set_level(curr_proc, curr_proc->p_base_prio);
+}
+#endif
+
+/* Return TRUE if the end of the time slice of curr_proc matters, i.e. if there's a ready
+ * process which could run in its place, or if curr_proc is a real time job with a budget. */
+bool slice_needed(){
+    if(IS_RT(curr_proc) || !dlist_empty(rt_ready_queue))
+        return TRUE;
+    if(ready_bitmap == 0)
+        return FALSE;
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+    // curr_proc would be demoted, and sooner or later meet any ready process
+    return TRUE;
+#else
+    return highest_bit(ready_bitmap) >= curr_proc->p_prio;
+#endif
+}
+
+/* Return TRUE if a ready process has a higher priority than curr_proc: a real time
+ * process with an earlier deadline, or any real time process if curr_proc is not one */
+bool need_resched(){
+    if(curr_proc == NULL)
+        return FALSE;
+    if(!dlist_empty(rt_ready_queue)){
+        if(!IS_RT(curr_proc))
+            return TRUE;
+        struct pcb_t* first = headProcQ(&rt_ready_queue);
+        return (int)(first->p_rt_deadline - curr_proc->p_rt_deadline) < 0;
+    }
+    if(IS_RT(curr_proc))
+        return FALSE;
+    return ready_bitmap != 0 && highest_bit(ready_bitmap) > curr_proc->p_prio;
+}
+
+/* Load the given state into the processor, unless a process with a higher priority than
+ * curr_proc became ready in the meantime: in that case curr_proc is preempted. */
+void resume_or_preempt(state_t* area){
+    if(need_resched()){
+        curr_proc->p_s = *area;
+        schedule(SCHED_PROC_PREEMPTED);
+    }
+    // a process could have become ready, so the time slice of curr_proc could matter now
+    set_next_timer(TRUE);
+    LDST((void*) area);
+}
+
+/* Make p (which is curr_proc, or not in any queue) a real time process with the given
+ * period and budget, its first job is released now. Return FALSE if the overall utilization
+ * of real time processes would exceed SCHED_RT_MAX_UTIL. */
+bool rt_enter(struct pcb_t *p, cputime_t period, cputime_t budget){
+    unsigned int util = (budget * 1000) / period;
+    unsigned int old_util = IS_RT(p) ? (p->p_rt_budget * 1000) / p->p_rt_period : 0;
+    if(rt_util - old_util + util > SCHED_RT_MAX_UTIL)
+        return FALSE;
+    rt_util = rt_util - old_util + util;
+    p->p_rt_period = period;
+    p->p_rt_budget = budget;
+    p->p_rt_budget_left = budget;
+    p->p_rt_release = getTODLO();
+    p->p_rt_deadline = p->p_rt_release + period;
+    // the budget is charged from now on
+    p->p_run_start = p->usr_time + p->sys_time;
+    if(p == curr_proc)
+        slice_end = p->p_rt_release + budget;
+    return TRUE;
+}
+
+/* Make p a best effort process again. If it's waiting for its next job it's taken out
+ * of the release queue, the caller must take care of any other queue. */
+void rt_leave(struct pcb_t *p){
+    if(!IS_RT(p))
+        return;
+    if(p->p_rt_waiting){
+        outProcQ(&rt_release_queue, p);
+        p->p_rt_waiting = FALSE;
+        softblock_count--;
+    }
+    rt_util -= (p->p_rt_budget * 1000) / p->p_rt_period;
+    p->p_rt_period = 0;
+    if(p == curr_proc)
+        slice_end = getTODLO() + p->p_quantum;
+}
+
+/* Charge the cpu time p used since its dispatch to the budget of its current job */
+void rt_charge(struct pcb_t *p){
+    p->p_rt_budget_left -= (p->usr_time + p->sys_time) - p->p_run_start;
+}
+
+/* End the current job of p, which is not in any queue: p waits for the release of its next
+ * job at the next period boundary. If that's already passed the missed periods are skipped
+ * and p is ready again. */
+void rt_wait_next_period(struct pcb_t *p){
+    unsigned int now = getTODLO();
+    p->p_rt_release += p->p_rt_period;
+    if((int)(now - p->p_rt_release) >= 0){
+        p->p_rt_release += ((now - p->p_rt_release) / p->p_rt_period) * p->p_rt_period;
+        p->p_rt_deadline = p->p_rt_release + p->p_rt_period;
+        p->p_rt_budget_left = p->p_rt_budget;
+        ready_insert(p);
+        return;
+    }
+    p->p_rt_deadline = p->p_rt_release + p->p_rt_period;
+    p->p_rt_budget_left = p->p_rt_budget;
+    p->p_rt_waiting = TRUE;
+    // like a process waiting for the pseudo clock, the timer will wake it up
+    softblock_count++;
+    insert_sorted(&rt_release_queue, p, offsetof(struct pcb_t, p_rt_release));
+}
+
+/* Release the real time jobs whose release time has come */
+void rt_release_due(unsigned int now){
+    struct pcb_t* p;
+    while((p = headProcQ(&rt_release_queue)) != NULL && (int)(now - p->p_rt_release) >= 0){
+        removeProcQ(&rt_release_queue);
+        p->p_rt_waiting = FALSE;
+        softblock_count--;
+        ready_insert(p);
+    }
+}
+
+/* Return TRUE and the release time of the first job to be released in when, or FALSE
+ * if no real time process is waiting */
+bool rt_next_release(unsigned int *when){
+    struct pcb_t* p = headProcQ(&rt_release_queue);
+    if(p == NULL)
+        return FALSE;
+    *when = p->p_rt_release;
+    return TRUE;
+}
@@ -0,0 +1,91 @@
+/* Host side benchmark of mymemset/mymemcopy (helplib.c) against the plain byte loops
+ * they replaced. Every size is also checked against the byte loops, aligned and not.
+ * Build and run it with: make runbench */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <types.h>
+#include <helplib.h>
+
+#define BUFLEN 8192
+#define ROUNDS 200000
+
+static unsigned char src[BUFLEN + 8], dst[BUFLEN + 8], ref[BUFLEN + 8];
+
+/* the byte by byte versions, as they were */
+static void* byte_memset(void* s, int c, size_t n) {
+	unsigned char* p = (unsigned char*)s;
+	unsigned char tmp = c & 0xff;
+	while (n--)
+		*p++ = tmp;
+	return s;
+}
+
+static void byte_memcopy(void* from, void* to, size_t n) {
+	char *cfrom = (char *)from;
+	char *cto = (char *)to;
+	for (int i=0; i<n; i++)
+		cto[i] = cfrom[i];
+}
+
+/* seconds taken by ROUNDS calls of the given function on n bytes */
+static double time_set(void* (*f)(void*, int, size_t), size_t n) {
+	clock_t start = clock();
+	for (int i = 0; i < ROUNDS; i++) {
+		f(dst, i, n);
+		__asm__ volatile("" : : : "memory");
+	}
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static double time_copy(void (*f)(void*, void*, size_t), size_t n) {
+	clock_t start = clock();
+	for (int i = 0; i < ROUNDS; i++) {
+		f(src, dst, n);
+		__asm__ volatile("" : : : "memory");
+	}
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* compare the results with the byte loops for every offset of source and destination */
+static int check(size_t n) {
+	for (int so = 0; so < 4; so++) {
+		for (int d = 0; d < 4; d++) {
+			for (int i = 0; i < BUFLEN + 8; i++)
+				src[i] = rand();
+			memset(dst, 0x55, sizeof(dst));
+			memset(ref, 0x55, sizeof(ref));
+			mymemcopy(src + so, dst + d, n);
+			byte_memcopy(src + so, ref + d, n);
+			if (memcmp(dst, ref, sizeof(dst)) != 0)
+				return 0;
+			mymemset(dst + d, so + 0x1A5, n);
+			byte_memset(ref + d, so + 0x1A5, n);
+			if (memcmp(dst, ref, sizeof(dst)) != 0)
+				return 0;
+		}
+	}
+	return 1;
+}
+
+int main()
+{
+	size_t sizes[] = { 3, 17, sizeof(state_t), sizeof(struct pcb_t), 1024, 4096, BUFLEN };
+	int failed = 0;
+
+	printf("%8s %12s %12s %12s %12s\n", "bytes", "byte set", "mymemset", "byte copy", "mymemcopy");
+	for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		size_t n = sizes[i];
+		if (!check(n)) {
+			printf("%8zu: wrong result\n", n);
+			failed = 1;
+			continue;
+		}
+		printf("%8zu %11.3fs %11.3fs %11.3fs %11.3fs\n", n,
+				time_set(byte_memset, n), time_set(mymemset, n),
+				time_copy(byte_memcopy, n), time_copy(mymemcopy, n));
+	}
+	return failed;
+}
@@ -34,15 +34,20 @@
 #include "const.h"
 
 #include "clist.h"
+#include "dlist.h"
 #include "pcb.h"
 #include "asl.h"
+#include "helplib.h"
 
 #define	MAXSEM	MAXPROC
 
 int sem[MAXSEM];
 int onesem;
+/* 4KB apart: the semaphores bsem[0], bsem[1024] and bsem[2048] share an ASL bucket */
+int bsem[2 * 1024 + 1];
+char mbuf[2][64];
 struct pcb_t	*procp[MAXPROC], *p, *q, *firstproc, *lastproc, *midproc;
-struct clist qa;
+struct dlist qa, qb;
 
 /* This function places the specified character string in okbuf and
  *      causes the string to be written out to terminal0 */
@@ -61,7 +66,7 @@ void adderrbuf(char *strp) {
 
 int main() {
 	int i;
-	struct clist empty=CLIST_INIT;
+	struct dlist empty=DLIST_INIT;
 
 	initPcbs();
 	addokbuf("Initialized process control blocks   \n");
@@ -71,11 +76,21 @@ int main() {
 		if ((procp[i] = allocPcb()) == NULL)
 			adderrbuf("allocPcb(): unexpected NULL   ");
 	}
-	if (allocPcb() != NULL) {
-		adderrbuf("allocPcb(): allocated more than MAXPROC entries   ");
+	/* the pool grows as needed */
+	if ((p = allocPcb()) == NULL) {
+		adderrbuf("allocPcb(): unexpected NULL after MAXPROC entries   ");
 	}
+	freePcb(p);
 	addokbuf("allocPcb ok   \n");
 
+	/* a lazily initialized pcb must still be ready for the queue and tree functions */
+	if ((p = allocPcbLazy()) == NULL)
+		adderrbuf("allocPcbLazy(): unexpected NULL   ");
+	if (p->p_parent != NULL || p->p_cursem != NULL || !emptyChild(p))
+		adderrbuf("allocPcbLazy(): pcb not initialized   ");
+	freePcb(p);
+	addokbuf("allocPcbLazy ok   \n");
+
 	/* return the last 10 entries back to free list */
 	for (i = 10; i < MAXPROC; i++)
 		freePcb(procp[i]);
@@ -83,7 +98,7 @@ int main() {
 
 	/* create a 10-element process queue */
 	qa=empty;
-	if (!clist_empty(qa)) adderrbuf("clist_empty(qa): unexpected FALSE   ");
+	if (!dlist_empty(qa)) adderrbuf("dlist_empty(qa): unexpected FALSE   ");
 	addokbuf("Inserting...   \n");
 	for (i = 0; i < 10; i++) {
 		if ((q = allocPcb()) == NULL)
@@ -105,7 +120,7 @@ int main() {
 	}
 	addokbuf("inserted 10 elements   \n");
 
-	if (clist_empty(qa)) adderrbuf("clist_empty(qa): unexpected TRUE"   );
+	if (dlist_empty(qa)) adderrbuf("dlist_empty(qa): unexpected TRUE"   );
 
 	/* Check outProcQ and headProcQ */
 	if (headProcQ(&qa) != firstproc)
@@ -123,6 +138,14 @@ int main() {
 
 	if (outProcQ(&qa, procp[0]) != NULL)
 		adderrbuf("outProcQ(&qa, procp[0]) failed on nonexistent entry   ");
+
+	/* an entry of another queue is not in qa, and its queue is left alone */
+	qb = empty;
+	insertProcQ(&qb, procp[0]);
+	if (outProcQ(&qa, procp[0]) != NULL)
+		adderrbuf("outProcQ(&qa, procp[0]) failed on an entry of another queue   ");
+	if (removeProcQ(&qb) != procp[0] || !dlist_empty(qb))
+		adderrbuf("outProcQ(&qa, procp[0]) changed another queue   ");
 	addokbuf("outProcQ() ok   \n");
 
 	/* Check if removeProc and insertProc remove in the correct order */
@@ -139,10 +162,10 @@ int main() {
 	if (removeProcQ(&qa) != NULL)
 		adderrbuf("removeProcQ(&qa): removes too many entries   ");
 
-	if (!clist_empty(qa))
-		adderrbuf("clist_empty(qa): unexpected FALSE   ");
+	if (!dlist_empty(qa))
+		adderrbuf("dlist_empty(qa): unexpected FALSE   ");
 
-	addokbuf("insertProcQ(), removeProcQ() and clist_empty() ok   \n");
+	addokbuf("insertProcQ(), removeProcQ() and dlist_empty() ok   \n");
 	addokbuf("process queues module ok      \n");
 
 	addokbuf("checking process trees...\n");
@@ -216,8 +239,13 @@ int main() {
 	if (insertBlocked(&sem[11],p))
 		adderrbuf("removeBlocked(): fails to return to free list   ");
 
-	if (insertBlocked(&onesem, procp[9]) == FALSE)
-		adderrbuf("insertBlocked(): inserted more than MAXPROC   ");
+	/* semaphore descriptors grow as needed too */
+	q = allocPcb();
+	if (insertBlocked(&onesem, q))
+		adderrbuf("insertBlocked(): unexpected TRUE after MAXSEM semaphores   ");
+	if (removeBlocked(&onesem) != q)
+		adderrbuf("removeBlocked(): removed wrong element   ");
+	freePcb(q);
 
 	addokbuf("removeBlocked() test started   \n");
 	for (i = 10; i< MAXPROC; i++) {
@@ -256,7 +284,57 @@ int main() {
 	if (headBlocked(&sem[9]) != NULL)
 		adderrbuf("out/headBlocked: unexpected nonempty queue   ");
 	addokbuf("headBlocked() and outBlocked() ok   \n");
+
+	/* Check removeAllBlocked: sem[0] holds procp[0] and procp[10] */
+	qa = empty;
+	p = allocPcb();
+	insertProcQ(&qa, p);
+	if (removeAllBlocked(&sem[0], &qa) != 2)
+		adderrbuf("removeAllBlocked: wrong number of processes moved   ");
+	if (headBlocked(&sem[0]) != NULL)
+		adderrbuf("removeAllBlocked: unexpected nonempty queue   ");
+	if (removeAllBlocked(&sem[0], &qa) != 0)
+		adderrbuf("removeAllBlocked: moved processes from an empty queue   ");
+	if (removeProcQ(&qa) != p || removeProcQ(&qa) != procp[0])
+		adderrbuf("removeAllBlocked: wrong queue order   ");
+	if (removeProcQ(&qa) != procp[10] || !dlist_empty(qa))
+		adderrbuf("removeAllBlocked: wrong queue tail   ");
+	if (procp[0]->p_cursem != NULL || procp[10]->p_cursem != NULL)
+		adderrbuf("removeAllBlocked: p_cursem not reset   ");
+	freePcb(p);
+	addokbuf("removeAllBlocked() ok   \n");
+
+	/* Check semaphores which share an ASL bucket */
+	p = allocPcb();
+	if (insertBlocked(&bsem[0], procp[0]) || insertBlocked(&bsem[1024], procp[10]) ||
+			insertBlocked(&bsem[2048], p))
+		adderrbuf("insertBlocked(4): unexpected TRUE   ");
+	if (outBlocked(procp[10]) != procp[10] || headBlocked(&bsem[1024]) != NULL)
+		adderrbuf("outBlocked(3): wrong semaphore of a bucket   ");
+	if (headBlocked(&bsem[0]) != procp[0] || headBlocked(&bsem[2048]) != p)
+		adderrbuf("headBlocked(3): lost a semaphore of a bucket   ");
+	if (removeBlocked(&bsem[2048]) != p || removeBlocked(&bsem[0]) != procp[0])
+		adderrbuf("removeBlocked(2): wrong semaphore of a bucket   ");
+	if (headBlocked(&bsem[0]) != NULL || headBlocked(&bsem[2048]) != NULL)
+		adderrbuf("removeBlocked(2): unexpected nonempty queue   ");
+	freePcb(p);
+	addokbuf("semaphores sharing an ASL bucket ok   \n");
 	addokbuf("ASL module ok   \n");
+
+	/* Check mymemset and mymemcopy with unaligned addresses and odd lengths */
+	for (i = 0; i < 64; i++) {
+		mbuf[0][i] = 'a';
+		mbuf[1][i] = 'b';
+	}
+	mymemset(&mbuf[0][3], 'x', 41);
+	for (i = 0; i < 64; i++)
+		if (mbuf[0][i] != (i >= 3 && i < 44 ? 'x' : 'a'))
+			adderrbuf("mymemset: wrong byte   ");
+	mymemcopy(&mbuf[0][2], &mbuf[1][5], 43);
+	for (i = 0; i < 64; i++)
+		if (mbuf[1][i] != (i >= 5 && i < 48 ? mbuf[0][i - 3] : 'b'))
+			adderrbuf("mymemcopy: wrong byte   ");
+	addokbuf("mymemset() and mymemcopy() ok   \n");
 	addokbuf("So Long and Thanks for All the Fish\n");
 
 	return 0;
@@ -37,9 +37,12 @@
 #include <uARMconst.h>
 #include <uARMtypes.h>
 #include <libuarm.h>
+#include <arch.h>
 #include <const.h>
 
 #include <pcb.h>
+#include <exceptions.h>
+#include <bcache.h>
 
 typedef unsigned int devregtr;
 /* if these are not defined */
@@ -47,6 +50,7 @@ typedef unsigned int cpu_t;
 
 /* hardware constants */
 #define PRINTCHR	2
+#define RECVCHR	2
 #define BYTELEN	8
 #define RECVD	5
 #define TRANSM 5
@@ -91,6 +95,11 @@ typedef unsigned int cpu_t;
 #define SEMAPHORE		int
 #define NOLEAVES		4	/* number of leaves of p8 process tree */
 #define MAXSEM			20
+#define P10INFLIGHT		4	/* p10's IODEVOPASYNC not reaped yet */
+#define P10BLOCKS		(DISK_CACHE_BUFS + 4)	/* blocks p10 writes on disk 0 */
+#define P10WORDS		(DISK_BLOCK_SIZE / sizeof(unsigned int))
+#define P11PERIOD		20000	/* period of p11's real time child */
+#define P11DEPTH		8		/* depth of p11's process chain */
 
 
 
@@ -114,11 +123,45 @@ SEMAPHORE term_mut=1,		/* for mutual exclusion on terminal */
 	endp8=0,		/* to signal demise of p8 */
 	endcreate=0,		/* for a p8 leaf to signal its creation */
 	blkleaves=0,		/* for a p8 leaf to block */
-	blkp8=0;		/* to block p8 */
+	blkp8=0,		/* to block p8 */
+	endp9=0,		/* to signal demise of p9 */
+	synp9=0,		/* for p9's children to say they are about to do I/O */
+	blkp9=0,		/* to block p9's children */
+	endp10=0,		/* to signal demise of p10 */
+	synp10=0,		/* for p10's children to say they are about to block */
+	blkp10=0,		/* to block p10's children */
+	endp10io=0,		/* for p10's IODEVOP child to say its status was right */
+	semvp10a=0,		/* the SEMOPV of p10's child */
+	semvp10b=0,
+	endp11=0,		/* to signal demise of p11 */
+	synp11=0,		/* for p11's children to say they are about to block */
+	blkp11=0,		/* to block p11's children */
+	p11sema=0,		/* the SEMOPV of p11's child */
+	p11semb=0;
 
 state_t p2state, p3state, p4state, p5state, p5auxstate, p6state, p7state;
 state_t p8rootstate, child1state, child2state;
 state_t gchild1state, gchild2state, gchild3state, gchild4state;
+state_t p9state, p9astate, p9bstate;
+state_t p10state, p10astate, p10bstate, p10cstate;
+state_t p11state, p11astate, p11bstate, p11cstate;
+
+char p10msg[] = "p10 - TERMWRITE OK\n";
+char p10async[] = "p10 - IODEVOPASYNC and IOREAP OK\n";
+char p10cut[] = "p10 - this line is cut short when its writer is killed, no matter where\n";
+char p11wa[] = "p11 - TERMWRITE of the first writer\n";
+char p11wb[] = "p11 - TERMWRITE of the second writer, after the first one\n";
+char p11cq[] = "p11 - full IODEVOPASYNC completion queue OK\n";
+char p10line[16];					/* for p10's TERMREAD */
+unsigned int p10wblk[P10WORDS], p10rblk[P10WORDS];	/* p10's disk blocks */
+struct semop_t p10ops[2] = {{&semvp10a, -1}, {&semvp10b, -1}};
+struct semop_t p11ops[2] = {{&p11sema, -1}, {&p11semb, -1}};
+struct semop_t p11dup[2] = {{&p11sema, 1}, {&p11sema, 1}};
+
+volatile int p11flag;		/* set by p11's children when they run */
+volatile unsigned int p11count[2];	/* loops of p11's CPU bound children */
+volatile int p11seq[4], p11n;		/* the order in which p11's children woke up */
+pid_t p11pids[MAXPROC];			/* p11's many children */
 
 int p1p2synch = 0;	/* to check on p1/p2 synchronization */
 
@@ -137,6 +180,10 @@ pid_t p8pid, leaf1pid, leaf2pid, leaf3pid, leaf4pid;	/* p8 and it's grandchilds'
 
 void	p2(),p3(),p4(),p5(),p5a(),p5b(),p5c(),p6(),p7(),p7a(),p5prog(),p5mm();
 void	p5sys(),p6a(),p6b(),p6c(),p8root(),child1(),child2(),p8leaf();
+void	p9(),p9io();
+void	p10(),p10write(),p10io(),p10reap(),p10read(),p10disk(),p10semv();
+void	p11(),p11mark(),p11hog(),p11spin(),p11job(),p11sleep(),p11semv(),p11post(),p11chain();
+void	p11trap(),p11dirty(),p11clean(),p11wait(),p11tick(),p11write();
 
 /* a procedure to print on terminal 0 */
 void print(char *msg) {
@@ -276,6 +323,57 @@ void test() {
 	gchild4state.sp = gchild3state.sp - QPAGE;
 	gchild4state.pc = (memaddr)p8leaf;
 	gchild4state.cpsr = STATUS_ALL_INT_ENABLE(gchild4state.cpsr);
+
+	STST(&p9state);
+	p9state.sp = gchild4state.sp - QPAGE;
+	p9state.pc = (memaddr)p9;
+	p9state.cpsr = STATUS_ALL_INT_ENABLE(p9state.cpsr);
+
+	STST(&p9astate);
+	p9astate.sp = p9state.sp - QPAGE;
+	p9astate.pc = (memaddr)p9io;
+	p9astate.cpsr = STATUS_ALL_INT_ENABLE(p9astate.cpsr);
+
+	STST(&p9bstate);
+	p9bstate.sp = p9astate.sp - QPAGE;
+	p9bstate.pc = (memaddr)p9io;
+	p9bstate.cpsr = STATUS_ALL_INT_ENABLE(p9bstate.cpsr);
+
+	/* p10's children get their pc when they are created */
+	STST(&p10state);
+	p10state.sp = p9bstate.sp - QPAGE;
+	p10state.pc = (memaddr)p10;
+	p10state.cpsr = STATUS_ALL_INT_ENABLE(p10state.cpsr);
+
+	STST(&p10astate);
+	p10astate.sp = p10state.sp - QPAGE;
+	p10astate.cpsr = STATUS_ALL_INT_ENABLE(p10astate.cpsr);
+
+	STST(&p10bstate);
+	p10bstate.sp = p10astate.sp - QPAGE;
+	p10bstate.cpsr = STATUS_ALL_INT_ENABLE(p10bstate.cpsr);
+
+	STST(&p10cstate);
+	p10cstate.sp = p10bstate.sp - QPAGE;
+	p10cstate.cpsr = STATUS_ALL_INT_ENABLE(p10cstate.cpsr);
+
+	/* p11's children get their pc and their argument when they are created */
+	STST(&p11state);
+	p11state.sp = p10cstate.sp - QPAGE;
+	p11state.pc = (memaddr)p11;
+	p11state.cpsr = STATUS_ALL_INT_ENABLE(p11state.cpsr);
+
+	STST(&p11astate);
+	p11astate.sp = p11state.sp - QPAGE;
+	p11astate.cpsr = STATUS_ALL_INT_ENABLE(p11astate.cpsr);
+
+	STST(&p11bstate);
+	p11bstate.sp = p11astate.sp - QPAGE;
+	p11bstate.cpsr = STATUS_ALL_INT_ENABLE(p11bstate.cpsr);
+
+	STST(&p11cstate);
+	p11cstate.sp = p11bstate.sp - QPAGE;
+	p11cstate.cpsr = STATUS_ALL_INT_ENABLE(p11cstate.cpsr);
 	
 	/* create process p2 */
 	SYSCALL(CREATEPROCESS, (int)&p2state, 0, 0);				/* start p2     */
@@ -354,6 +452,27 @@ void test() {
 
 		SYSCALL(SEMOP, (int)&blkp8, 1, 0);
 	}
+
+	/* termination of processes waiting for their I/O */
+	SYSCALL(CREATEPROCESS, (int)&p9state, 0, 0);
+
+	SYSCALL(SEMOP, (int)&endp9, -1, 0);
+
+	print("p1 knows p9 ended\n");
+
+	/* the I/O extensions of the nucleus */
+	SYSCALL(CREATEPROCESS, (int)&p10state, 0, 0);
+
+	SYSCALL(SEMOP, (int)&endp10, -1, 0);
+
+	print("p1 knows p10 ended\n");
+
+	/* the other extensions of the nucleus */
+	SYSCALL(CREATEPROCESS, (int)&p11state, 0, 0);
+
+	SYSCALL(SEMOP, (int)&endp11, -1, 0);
+
+	print("p1 knows p11 ended\n");
 	
 	print("p1 finishes OK -- TTFN\n");
 	* ((memaddr *) BADADDR) = 0;				/* terminate p1 */
@@ -835,3 +954,964 @@ void p8leaf() {
 	print("error: p8 grandchild was not killed with father\n");
 	PANIC();
 }
+
+/* p9 -- termination of processes waiting for their IODEVOP */
+void p9() {
+	pid_t	apid, bpid;
+	int	prio;
+
+	print("p9 starts\n");
+
+	/* keep everybody else off terminal 0 */
+	SYSCALL(SEMOP, (int)&term_mut, -1, 0);
+
+	/* the first child's IODEVOP is sent to the terminal, the second */
+	/* one is queued behind it in the nucleus                        */
+	apid = SYSCALL(CREATEPROCESS, (int)&p9astate, 0, 0);
+	bpid = SYSCALL(CREATEPROCESS, (int)&p9bstate, 0, 0);
+
+	/* let them run until they block */
+	prio = SYSCALL(SETPRIORITY, SCHED_PRIO_MIN, 0, 0);
+	SYSCALL(SEMOP, (int)&synp9, -2, 0);
+	SYSCALL(SETPRIORITY, prio, 0, 0);
+
+	/* kill the owner of the request in progress first, then the one */
+	/* whose request is queued: the device semaphore must not be     */
+	/* given back twice when the first request is over               */
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+	SYSCALL(TERMINATEPROCESS, (int)bpid, 0, 0);
+
+	SYSCALL(SEMOP, (int)&term_mut, 1, 0);
+
+	/* print waits for its own IODEVOP, and checks its status */
+	print("p9 - killing processes waiting for IODEVOP OK\n");
+
+	SYSCALL(SEMOP, (int)&endp9, 1, 0);
+
+	SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+
+	print("error: p9 didn't terminate\n");
+	PANIC();
+}
+
+/* p9io -- a child of p9, killed while waiting for its IODEVOP */
+void p9io() {
+	SYSCALL(SEMOP, (int)&synp9, 1, 0);
+
+	/* a newline, so the terminal output is not garbled */
+	SYSCALL(IODEVOP, PRINTCHR | (((devregtr) '\n') << BYTELEN), INT_TERMINAL, 0);
+
+	/* if the transmission ended before p9 killed us */
+	SYSCALL(SEMOP, (int)&blkp9, -1, 0);
+
+	print("error: p9 child was not killed\n");
+	PANIC();
+}
+
+/* start one of p10's children in pc */
+pid_t p10child(state_t *state, memaddr pc) {
+	state->pc = pc;
+	return SYSCALL(CREATEPROCESS, (int)state, 0, 0);
+}
+
+/* let n of p10's children run until they block */
+void p10block(int n) {
+	int	prio;
+
+	prio = SYSCALL(SETPRIORITY, SCHED_PRIO_MIN, 0, 0);
+	SYSCALL(SEMOP, (int)&synp10, -n, 0);
+	SYSCALL(SETPRIORITY, prio, 0, 0);
+}
+
+/* wait for the completion of the IODEVOPASYNC transmitting c on terminal 0 */
+void p10char(char c) {
+	struct io_completion	comp;
+
+	if (SYSCALL(IOREAP, (int)&comp, TRUE, 0) != 1)
+		PANIC();
+
+	/* the requests are served in order */
+	if (comp.line != INT_TERMINAL || comp.dnum != 0 ||
+			(comp.status & TERMSTATMASK) != TRANSM ||
+			((comp.status & TERMCHARMASK) >> BYTELEN) != c)
+		PANIC();
+}
+
+/* p10 -- the I/O extensions of the nucleus: TERMWRITE, TERMREAD, IODEVOPASYNC, IOREAP, */
+/* DISKREAD, DISKWRITE and DISKSYNC, with their processes killed while they wait       */
+void p10() {
+	struct io_completion	comp;
+	pid_t	apid, bpid, cpid;
+	int		i;
+	unsigned int	j;
+
+	print("p10 starts\n");
+
+	/* keep everybody else off terminal 0, and don't print while holding it */
+	SYSCALL(SEMOP, (int)&term_mut, -1, 0);
+
+	if (SYSCALL(TERMWRITE, 0, (int)p10msg, sizeof(p10msg) - 1) != sizeof(p10msg) - 1)
+		PANIC();
+
+	/* the first character is sent at once, the next ones are queued in the nucleus */
+	for (i = 0; p10async[i] != '\0'; i++) {
+		if (i >= P10INFLIGHT)
+			p10char(p10async[i - P10INFLIGHT]);
+		if (SYSCALL(IODEVOPASYNC, PRINTCHR | (((devregtr) p10async[i]) << BYTELEN),
+				INT_TERMINAL, 0) != IODEVOPASYNC_OK)
+			PANIC();
+	}
+	for (i -= P10INFLIGHT; p10async[i] != '\0'; i++)
+		p10char(p10async[i]);
+
+	/* nothing left to reap, nor to wait for */
+	if (SYSCALL(IOREAP, (int)&comp, FALSE, 0) != 0 ||
+			SYSCALL(IOREAP, (int)&comp, TRUE, 0) != IOREAP_ERROR)
+		PANIC();
+
+	/* a TERMWRITE, an IODEVOP queued behind it and an IODEVOPASYNC queued behind */
+	/* both: the writer and the process waiting in IOREAP are killed, the IODEVOP */
+	/* must still get its own status                                              */
+	apid = p10child(&p10astate, (memaddr)p10write);
+	bpid = p10child(&p10bstate, (memaddr)p10io);
+	cpid = p10child(&p10cstate, (memaddr)p10reap);
+	p10block(3);
+
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+	SYSCALL(TERMINATEPROCESS, (int)cpid, 0, 0);
+	SYSCALL(SEMOP, (int)&endp10io, -1, 0);
+	SYSCALL(TERMINATEPROCESS, (int)bpid, 0, 0);
+
+	/* a reader waiting for a line which never comes */
+	apid = p10child(&p10astate, (memaddr)p10read);
+	p10block(1);
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+
+	SYSCALL(SEMOP, (int)&term_mut, 1, 0);
+
+	print("p10 - killing processes waiting for terminal I/O OK\n");
+
+	/* a SEMOPV waiter which got its first semaphore but didn't run yet */
+	apid = p10child(&p10astate, (memaddr)p10semv);
+	p10block(1);
+	SYSCALL(SEMOP, (int)&semvp10a, 1, 0);
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+
+	/* the unit it held is given back */
+	if (SYSCALL(SEMOP, (int)&semvp10a, -1, SEMOP_TRY) != SEMOP_OK) {
+		print("error: SEMOPV units lost with their process\n");
+		PANIC();
+	}
+
+	print("p10 - killing a SEMOPV process OK\n");
+
+	if (((devreg_t *) DEV_REG_ADDR(INT_DISK, 0))->dtp.status == DEV_NOT_INSTALLED) {
+		print("p10 - no disk 0, disk cache not tested\n");
+	}
+	else {
+		/* more blocks than the cache has buffers: the least recently used */
+		/* ones are written back to make room for the others               */
+		for (i = 0; i < P10BLOCKS; i++) {
+			for (j = 0; j < P10WORDS; j++)
+				p10wblk[j] = (i << 16) | j;
+			if (SYSCALL(DISKWRITE, 0, i, (int)p10wblk) != DISK_OK) {
+				print("error: DISKWRITE failed\n");
+				PANIC();
+			}
+		}
+
+		if (SYSCALL(DISKSYNC, 0, 0, 0) != DISK_OK) {
+			print("error: DISKSYNC failed\n");
+			PANIC();
+		}
+
+		/* the first blocks are read from the disk again: seek, then read */
+		for (i = 0; i < P10BLOCKS; i++) {
+			if (SYSCALL(DISKREAD, 0, i, (int)p10rblk) != DISK_OK) {
+				print("error: DISKREAD failed\n");
+				PANIC();
+			}
+			for (j = 0; j < P10WORDS; j++)
+				if (p10rblk[j] != ((i << 16) | j)) {
+					print("error: DISKREAD read the wrong data\n");
+					PANIC();
+				}
+		}
+
+		if (SYSCALL(DISKREAD, 0, 0x7FFFFFFF, (int)p10rblk) != DISK_ERROR ||
+				SYSCALL(DISKREAD, DEV_PER_INT, 0, (int)p10rblk) != DISK_ERROR) {
+			print("error: DISKREAD of a block which doesn't exist\n");
+			PANIC();
+		}
+
+		/* the reader of a block not cached anymore is killed while it waits: */
+		/* the read goes on, and the next reader gets the block               */
+		apid = p10child(&p10astate, (memaddr)p10disk);
+		p10block(1);
+		SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+
+		if (SYSCALL(DISKREAD, 0, 0, (int)p10rblk) != DISK_OK || p10rblk[1] != 1) {
+			print("error: DISKREAD after its first reader was killed\n");
+			PANIC();
+		}
+
+		print("p10 - DISKREAD, DISKWRITE and DISKSYNC OK\n");
+	}
+
+	SYSCALL(SEMOP, (int)&endp10, 1, 0);
+
+	SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+
+	print("error: p10 didn't terminate\n");
+	PANIC();
+}
+
+/* p10write -- a child of p10, killed in the middle of its TERMWRITE */
+void p10write() {
+	SYSCALL(SEMOP, (int)&synp10, 1, 0);
+
+	SYSCALL(TERMWRITE, 0, (int)p10cut, sizeof(p10cut) - 1);
+
+	/* if the write ended before p10 killed us */
+	SYSCALL(SEMOP, (int)&blkp10, -1, 0);
+	PANIC();
+}
+
+/* p10io -- a child of p10, whose IODEVOP is queued behind a TERMWRITE */
+void p10io() {
+	devregtr	status;
+
+	SYSCALL(SEMOP, (int)&synp10, 1, 0);
+
+	status = SYSCALL(IODEVOP, PRINTCHR | (((devregtr) '\n') << BYTELEN), INT_TERMINAL, 0);
+
+	/* not the outcome of the TERMWRITE */
+	if ((status & TERMSTATMASK) != TRANSM || ((status & TERMCHARMASK) >> BYTELEN) != '\n')
+		PANIC();
+
+	SYSCALL(SEMOP, (int)&endp10io, 1, 0);
+	SYSCALL(SEMOP, (int)&blkp10, -1, 0);
+	PANIC();
+}
+
+/* p10reap -- a child of p10, killed while waiting for its IODEVOPASYNC */
+void p10reap() {
+	struct io_completion	comp;
+
+	SYSCALL(SEMOP, (int)&synp10, 1, 0);
+
+	if (SYSCALL(IODEVOPASYNC, PRINTCHR | (((devregtr) '\n') << BYTELEN),
+			INT_TERMINAL, 0) != IODEVOPASYNC_OK)
+		PANIC();
+	SYSCALL(IOREAP, (int)&comp, TRUE, 0);
+
+	SYSCALL(SEMOP, (int)&blkp10, -1, 0);
+	PANIC();
+}
+
+/* p10read -- a child of p10, killed while waiting in TERMREAD */
+void p10read() {
+	SYSCALL(SEMOP, (int)&synp10, 1, 0);
+
+	SYSCALL(TERMREAD, 0, (int)p10line, sizeof(p10line));
+
+	/* terminal 0 had some input */
+	SYSCALL(SEMOP, (int)&blkp10, -1, 0);
+	PANIC();
+}
+
+/* p10disk -- a child of p10, killed while waiting for its DISKREAD */
+void p10disk() {
+	SYSCALL(SEMOP, (int)&synp10, 1, 0);
+
+	/* block 0 was evicted by the last ones read */
+	SYSCALL(DISKREAD, 0, 0, (int)p10rblk);
+
+	SYSCALL(SEMOP, (int)&blkp10, -1, 0);
+	PANIC();
+}
+
+/* p10semv -- a child of p10, killed after getting half of its SEMOPV */
+void p10semv() {
+	SYSCALL(SEMOP, (int)&synp10, 1, 0);
+
+	SYSCALL(SEMOPV, (int)p10ops, 2, 0);
+
+	print("error: p10's SEMOPV didn't wait\n");
+	PANIC();
+}
+
+/* start one of p11's children in pc, with arg as its argument */
+pid_t p11child(state_t *state, memaddr pc, int arg) {
+	state->pc = pc;
+	state->a1 = arg;
+	return SYSCALL(CREATEPROCESS, (int)state, 0, 0);
+}
+
+/* let n of p11's children run until they block */
+void p11block(int n) {
+	int	prio;
+
+	prio = SYSCALL(SETPRIORITY, SCHED_PRIO_MIN, 0, 0);
+	SYSCALL(SEMOP, (int)&synp11, -n, 0);
+	SYSCALL(SETPRIORITY, prio, 0, 0);
+}
+
+/* return the objects of a kernel cache in use */
+unsigned int p11inuse(int cache) {
+	struct kmem_stats	stats;
+
+	if (SYSCALL(KMEMSTAT, cache, (int)&stats, 0) == KMEMSTAT_ERROR) {
+		print("error: KMEMSTAT failed\n");
+		PANIC();
+	}
+	return stats.in_use;
+}
+
+/* p11 -- the extensions of the nucleus beyond phase 2, one section each (p10 already */
+/* covered the killing of processes which wait for I/O)                               */
+void p11() {
+	cpu_t	time1, time2;
+	pid_t	apid, bpid;
+	int		i, prio;
+	unsigned int	used;
+	state_t	state;
+	struct kmem_stats	stats;
+	struct io_completion	comp;
+
+	print("p11 starts\n");
+
+	/* the highest priority ready process always runs */
+	prio = SYSCALL(SETPRIORITY, SCHED_PRIO_MAX, 0, 0);
+	if (prio == SETPRIORITY_ERROR || SYSCALL(SETPRIORITY, SCHED_PRIO_MAX + 1, 0, 0) != SETPRIORITY_ERROR ||
+			SYSCALL(SETPRIORITY, SCHED_PRIO_MIN - 1, 0, 0) != SETPRIORITY_ERROR) {
+		print("error: SETPRIORITY accepted a wrong priority\n");
+		PANIC();
+	}
+
+	/* the child inherits the top priority: it runs as soon as p11 lowers its own */
+	p11flag = 0;
+	apid = p11child(&p11astate, (memaddr)p11mark, 0);
+	if (SYSCALL(SETPRIORITY, SCHED_PRIO_MIN, 0, 0) != SCHED_PRIO_MAX || p11flag != 1) {
+		print("error: a lower priority process ran\n");
+		PANIC();
+	}
+	SYSCALL(SETPRIORITY, prio, 0, 0);
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+
+	print("p11 - SETPRIORITY OK\n");
+
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+	/* a CPU bound child which asked for the top priority is demoted level by level, */
+	/* until p11 gets the CPU back once it wakes up from WAITCLOCK                    */
+	prio = SYSCALL(SETPRIORITY, SCHED_PRIO_MIN + 1, 0, 0);
+	p11flag = 0;
+	apid = p11child(&p11astate, (memaddr)p11hog, 0);
+	SYSCALL(WAITCLOCK, 0, 0, 0);
+	if (p11flag != 1) {
+		print("error: MLFQ didn't run the CPU bound process\n");
+		PANIC();
+	}
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+	SYSCALL(SETPRIORITY, prio, 0, 0);
+
+	print("p11 - MLFQ demotion OK\n");
+#else
+	print("p11 - not built with MLFQ, demotion not tested\n");
+#endif
+
+	/* the timer is set for the next event only: with nobody ready the pseudo clock */
+	/* still ticks every CLOCKINTERVAL                                               */
+	SYSCALL(WAITCLOCK, 0, 0, 0);
+	time1 = getTODLO();
+	SYSCALL(WAITCLOCK, 0, 0, 0);
+	time2 = getTODLO();
+	if (time2 - time1 < (CLOCKINTERVAL >> 1) || time2 - time1 > (CLOCKINTERVAL << 1)) {
+		print("error: the pseudo clock ticked at the wrong time\n");
+		PANIC();
+	}
+
+	/* and with a process of the same priority ready, the time slice of p11 ends */
+	p11count[0] = 0;
+	apid = p11child(&p11astate, (memaddr)p11spin, 0);
+	time1 = getTODLO();
+	while (p11count[0] == 0 && getTODLO() - time1 < CLOCKINTERVAL)
+		;
+	if (p11count[0] == 0) {
+		print("error: the time slice of p11 didn't end\n");
+		PANIC();
+	}
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+
+	print("p11 - pseudo clock and time slice OK\n");
+
+	/* a longer time slice keeps the process of the same priority waiting */
+	if (SYSCALL(SETTIMESLICE, SCHED_QUANTUM_MIN - 1, 0, 0) != SETTIMESLICE_ERROR ||
+			SYSCALL(SETTIMESLICE, SCHED_QUANTUM_MAX + 1, 0, 0) != SETTIMESLICE_ERROR ||
+			SYSCALL(SETTIMESLICE, SCHED_QUANTUM_MAX, 0, 0) != SCHED_TIME_SLICE) {
+		print("error: SETTIMESLICE returned the wrong value\n");
+		PANIC();
+	}
+
+	/* the new time slice starts with the next dispatch */
+	SYSCALL(WAITCLOCK, 0, 0, 0);
+	p11count[0] = 0;
+	apid = p11child(&p11astate, (memaddr)p11spin, 0);
+	time1 = getTODLO();
+	while (getTODLO() - time1 < CLOCKINTERVAL)
+		;
+	if (p11count[0] != 0) {
+		print("error: the time slice of p11 ended too early\n");
+		PANIC();
+	}
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+	SYSCALL(SETTIMESLICE, SCHED_TIME_SLICE, 0, 0);
+
+	print("p11 - SETTIMESLICE OK\n");
+
+	if (SYSCALL(SETTICKETS, 0, 0, 0) != SETTICKETS_ERROR ||
+			SYSCALL(SETTICKETS, SCHED_TICKETS_MAX + 1, 0, 0) != SETTICKETS_ERROR ||
+			SYSCALL(SETTICKETS, 3 * SCHED_TICKETS_DEFAULT, 0, 0) != SCHED_TICKETS_DEFAULT) {
+		print("error: SETTICKETS returned the wrong value\n");
+		PANIC();
+	}
+
+	/* two CPU bound children below p11: the first one inherits three times the tickets */
+	/* of the second one, so with stride scheduling it gets about three times its share */
+	p11count[0] = 0;
+	p11count[1] = 0;
+	prio = SYSCALL(SETPRIORITY, SCHED_PRIO_MIN, 0, 0);
+	apid = p11child(&p11astate, (memaddr)p11spin, 0);
+	SYSCALL(SETTICKETS, SCHED_TICKETS_DEFAULT, 0, 0);
+	bpid = p11child(&p11bstate, (memaddr)p11spin, 1);
+	SYSCALL(SETPRIORITY, prio, 0, 0);
+
+	for (i = 0; i < 5; i++)
+		SYSCALL(WAITCLOCK, 0, 0, 0);
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+	SYSCALL(TERMINATEPROCESS, (int)bpid, 0, 0);
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+	if (p11count[1] == 0 || p11count[0] < 2 * p11count[1]) {
+		print("error: the CPU shares don't follow the tickets\n");
+		PANIC();
+	}
+#endif
+
+	print("p11 - SETTICKETS OK\n");
+
+	if (SYSCALL(SETREALTIME, SCHED_RT_PERIOD_MIN - 1, 1, 0) != SETREALTIME_ERROR ||
+			SYSCALL(SETREALTIME, SCHED_RT_PERIOD_MAX + 1, 1, 0) != SETREALTIME_ERROR ||
+			SYSCALL(SETREALTIME, P11PERIOD, P11PERIOD + 1, 0) != SETREALTIME_ERROR ||
+			SYSCALL(SETREALTIME, P11PERIOD, P11PERIOD, 0) != SETREALTIME_ERROR ||
+			SYSCALL(SETREALTIME, 0, 0, 0) != 0) {
+		print("error: SETREALTIME accepted wrong parameters\n");
+		PANIC();
+	}
+
+	/* a real time child runs every period, even while p11 spins with the top priority */
+	p11count[0] = 0;
+	apid = p11child(&p11astate, (memaddr)p11job, P11PERIOD);
+	p11block(1);
+	prio = SYSCALL(SETPRIORITY, SCHED_PRIO_MAX, 0, 0);
+	time1 = getTODLO();
+	while (getTODLO() - time1 < CLOCKINTERVAL)
+		;
+	SYSCALL(SETPRIORITY, prio, 0, 0);
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+	if (p11count[0] < (CLOCKINTERVAL / P11PERIOD) / 2) {
+		print("error: the real time process missed its periods\n");
+		PANIC();
+	}
+
+	print("p11 - SETREALTIME OK\n");
+
+	if (SYSCALL(SLEEP, 0, 0, 0) != 0 || SYSCALL(SLEEP, (int)0x80000000, 0, 0) != SLEEP_ERROR) {
+		print("error: wrong SLEEP result\n");
+		PANIC();
+	}
+
+	/* the wake up time doesn't wait for the pseudo-clock tick */
+	time1 = getTODLO();
+	SYSCALL(SLEEP, 20000, 0, 0);
+	time2 = getTODLO();
+	if (time2 - time1 < 20000 || time2 - time1 >= CLOCKINTERVAL) {
+		print("error: SLEEP didn't last as long as requested\n");
+		PANIC();
+	}
+
+	/* the shorter sleep ends first, whatever the order the sleepers went to sleep */
+	p11n = 0;
+	p11child(&p11astate, (memaddr)p11sleep, 30000);
+	p11child(&p11bstate, (memaddr)p11sleep, 10000);
+	SYSCALL(SEMOP, (int)&synp11, -2, 0);
+	if (p11n != 2 || p11seq[0] != 10000 || p11seq[1] != 30000) {
+		print("error: sleeping processes woke up in the wrong order\n");
+		PANIC();
+	}
+
+	print("p11 - SLEEP OK\n");
+
+	if (SYSCALL(SEMOPV, (int)p11ops, 0, 0) != SEMOPV_ERROR ||
+			SYSCALL(SEMOPV, (int)p11ops, SEMOPV_MAX + 1, 0) != SEMOPV_ERROR ||
+			SYSCALL(SEMOPV, (int)p11dup, 2, 0) != SEMOPV_ERROR || p11sema != 0) {
+		print("error: SEMOPV accepted a wrong vector\n");
+		PANIC();
+	}
+
+	/* the child waits for p11semb without holding p11sema meanwhile */
+	p11flag = 0;
+	p11sema = 1;
+	p11child(&p11astate, (memaddr)p11semv, 0);
+	SYSCALL(SLEEP, 10000, 0, 0);
+	if (p11flag != 0 || p11sema != 1) {
+		print("error: SEMOPV held a semaphore while waiting\n");
+		PANIC();
+	}
+
+	/* both at once */
+	SYSCALL(SEMOP, (int)&p11semb, 1, 0);
+	SYSCALL(SEMOP, (int)&synp11, -1, 0);
+	if (p11flag != 1 || p11sema != 0 || p11semb != 0) {
+		print("error: SEMOPV didn't perform the whole vector\n");
+		PANIC();
+	}
+
+	print("p11 - SEMOPV OK\n");
+
+	if (SYSCALL(SEMOP, (int)&p11sema, -1, SEMOP_TRY) != SEMOP_WOULDBLOCK || p11sema != 0) {
+		print("error: a SEMOP_TRY waited\n");
+		PANIC();
+	}
+
+	time1 = getTODLO();
+	if (SYSCALL(SEMOP, (int)&p11sema, -1, 20000) != SEMOP_TIMEDOUT || p11sema != 0) {
+		print("error: a timed SEMOP didn't time out\n");
+		PANIC();
+	}
+	if (getTODLO() - time1 < 20000) {
+		print("error: a timed SEMOP timed out too early\n");
+		PANIC();
+	}
+
+	/* a V before the timeout ends the wait at once */
+	p11child(&p11astate, (memaddr)p11post, 10000);
+	time1 = getTODLO();
+	if (SYSCALL(SEMOP, (int)&p11sema, -1, 1000000) != SEMOP_OK || p11sema != 0 ||
+			getTODLO() - time1 >= 500000) {
+		print("error: a timed SEMOP wasn't woken up by a V\n");
+		PANIC();
+	}
+
+	print("p11 - timed SEMOP OK\n");
+
+	apid = p11child(&p11astate, (memaddr)p11mark, 0);
+	if (apid == 0 || apid == CREATE_PROCESS_ERROR || SYSCALL(GETPID, 0, 0, 0) == 0) {
+		print("error: wrong pid\n");
+		PANIC();
+	}
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+
+	/* the stale pid of the dead child doesn't kill the new one */
+	p11flag = 0;
+	bpid = p11child(&p11astate, (memaddr)p11mark, 0);
+	if (bpid == apid) {
+		print("error: a pid was reused at once\n");
+		PANIC();
+	}
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+	SYSCALL(SLEEP, 10000, 0, 0);
+	if (p11flag != 1) {
+		print("error: a stale pid killed a process\n");
+		PANIC();
+	}
+	SYSCALL(TERMINATEPROCESS, (int)bpid, 0, 0);
+
+	print("p11 - pids OK\n");
+
+	/* killing the root of a deep tree frees all of it */
+	used = p11inuse(KMEM_CACHE_PCB);
+	apid = p11child(&p11astate, (memaddr)p11chain, P11DEPTH);
+	p11block(P11DEPTH + 1);
+	if (p11inuse(KMEM_CACHE_PCB) != used + P11DEPTH + 1) {
+		print("error: wrong number of pcbs in use\n");
+		PANIC();
+	}
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+	if (p11inuse(KMEM_CACHE_PCB) != used) {
+		print("error: a process tree wasn't freed\n");
+		PANIC();
+	}
+
+	print("p11 - killing a deep process tree OK\n");
+
+	/* MAXPROC more processes, beyond the phase 2 limit (small stacks, they only block) */
+	used = p11inuse(KMEM_CACHE_PCB);
+	state = p11cstate;
+	for (i = 0; i < MAXPROC; i++) {
+		state.sp = p11cstate.sp - QPAGE - i * (QPAGE / 4);
+		p11pids[i] = p11child(&state, (memaddr)p11chain, 0);
+		if (p11pids[i] == CREATE_PROCESS_ERROR) {
+			print("error: the nucleus ran out of pcbs\n");
+			PANIC();
+		}
+	}
+	p11block(MAXPROC);
+	if (p11inuse(KMEM_CACHE_PCB) != used + MAXPROC) {
+		print("error: wrong number of pcbs in use\n");
+		PANIC();
+	}
+	for (i = 0; i < MAXPROC; i++)
+		SYSCALL(TERMINATEPROCESS, (int)p11pids[i], 0, 0);
+	if (p11inuse(KMEM_CACHE_PCB) != used) {
+		print("error: pcbs weren't given back\n");
+		PANIC();
+	}
+
+	if (SYSCALL(KMEMSTAT, KMEM_CACHE_IOREQ + 1, (int)&stats, 0) != KMEMSTAT_ERROR) {
+		print("error: KMEMSTAT of a cache which doesn't exist\n");
+		PANIC();
+	}
+
+	print("p11 - growable pools OK\n");
+
+	/* the handler states are allocated only for the processes which define a handler */
+	used = p11inuse(KMEM_CACHE_EXCP);
+	apid = p11child(&p11astate, (memaddr)p11trap, FALSE);
+	p11block(1);
+	if (p11inuse(KMEM_CACHE_EXCP) != used + 1) {
+		print("error: no handler state for a SPECSYSHDL\n");
+		PANIC();
+	}
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+	if (p11inuse(KMEM_CACHE_EXCP) != used) {
+		print("error: the handler state of a dead process wasn't freed\n");
+		PANIC();
+	}
+
+	/* without a handler, there's no trap to exit from */
+	p11flag = 0;
+	used = p11inuse(KMEM_CACHE_PCB);
+	p11child(&p11astate, (memaddr)p11trap, TRUE);
+	SYSCALL(SLEEP, 10000, 0, 0);
+	if (p11flag != 0 || p11inuse(KMEM_CACHE_PCB) != used) {
+		print("error: EXITTRAP without a handler didn't kill the process\n");
+		PANIC();
+	}
+
+	print("p11 - handler states OK\n");
+
+	/* a process which leaves its pcb with a handler, I/O completions and CPU time... */
+	SYSCALL(SEMOP, (int)&term_mut, -1, 0);
+	apid = p11child(&p11astate, (memaddr)p11dirty, 0);
+	p11block(1);
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+	SYSCALL(SEMOP, (int)&term_mut, 1, 0);
+
+	/* ...and a new one, which finds none of them */
+	p11flag = 0;
+	apid = p11child(&p11astate, (memaddr)p11clean, 0);
+	SYSCALL(SLEEP, 10000, 0, 0);
+	if (p11flag != 1) {
+		print("error: a new process got the state of a dead one\n");
+		PANIC();
+	}
+	SYSCALL(TERMINATEPROCESS, (int)apid, 0, 0);
+
+	print("p11 - new processes OK\n");
+
+	/* a process killed in the middle of a semaphore queue leaves it in order */
+	p11n = 0;
+	p11child(&p11astate, (memaddr)p11wait, 1);
+	bpid = p11child(&p11bstate, (memaddr)p11wait, 2);
+	p11child(&p11cstate, (memaddr)p11wait, 3);
+	SYSCALL(SLEEP, 10000, 0, 0);
+	SYSCALL(TERMINATEPROCESS, (int)bpid, 0, 0);
+	SYSCALL(SEMOP, (int)&p11sema, 1, 0);
+	SYSCALL(SEMOP, (int)&p11sema, 1, 0);
+	SYSCALL(SEMOP, (int)&synp11, -2, 0);
+	if (p11n != 2 || p11seq[0] != 1 || p11seq[1] != 3 || p11sema != 0) {
+		print("error: wrong semaphore queue after a kill\n");
+		PANIC();
+	}
+
+	print("p11 - semaphore queues OK\n");
+
+	/* the processes waiting for the pseudo-clock tick all wake up at once */
+	p11n = 0;
+	SYSCALL(WAITCLOCK, 0, 0, 0);
+	p11child(&p11astate, (memaddr)p11tick, 0);
+	p11child(&p11bstate, (memaddr)p11tick, 0);
+	p11child(&p11cstate, (memaddr)p11tick, 0);
+	SYSCALL(SEMOP, (int)&synp11, -3, 0);
+	if ((unsigned int)p11seq[2] - (unsigned int)p11seq[0] >= CLOCKINTERVAL / 2) {
+		print("error: WAITCLOCK didn't wake up all the processes at the tick\n");
+		PANIC();
+	}
+
+	print("p11 - WAITCLOCK OK\n");
+
+	if (((devreg_t *) DEV_REG_ADDR(INT_DISK, 0))->dtp.status == DEV_NOT_INSTALLED) {
+		print("p11 - no disk 0, interrupts of different lines not tested\n");
+	}
+	else {
+		/* a seek and a transmission in progress together: both interrupts are served */
+		SYSCALL(SEMOP, (int)&term_mut, -1, 0);
+		if (SYSCALL(IODEVOPASYNC, DEV_DISK_C_SEEKCYL, INT_DISK, 0) != IODEVOPASYNC_OK ||
+				SYSCALL(IODEVOPASYNC, PRINTCHR | (((devregtr) '\n') << BYTELEN),
+					INT_TERMINAL, 0) != IODEVOPASYNC_OK)
+			PANIC();
+		i = 0;
+		while (SYSCALL(IOREAP, (int)&comp, TRUE, 0) == 1) {
+			if (comp.line == INT_DISK && (char)comp.status == DEV_S_READY)
+				i |= 1;
+			else if (comp.line == INT_TERMINAL && (comp.status & TERMSTATMASK) == TRANSM)
+				i |= 2;
+		}
+		SYSCALL(SEMOP, (int)&term_mut, 1, 0);
+		if (i != 3) {
+			print("error: an interrupt was lost\n");
+			PANIC();
+		}
+
+		print("p11 - interrupts of different lines OK\n");
+	}
+
+	/* only devices which are there get a command */
+	if (SYSCALL(IODEVOP, PRINTCHR | (((devregtr) '\n') << BYTELEN), INT_TERMINAL, 1) != DEV_NOT_INSTALLED ||
+			SYSCALL(IODEVOP, PRINTCHR, INT_TERMINAL, DEV_PER_INT) != DEV_NOT_INSTALLED ||
+			SYSCALL(IODEVOP, PRINTCHR, INT_LOWEST - 1, 0) != DEV_NOT_INSTALLED ||
+			SYSCALL(IODEVOPASYNC, PRINTCHR, INT_TERMINAL, 1) != IODEVOPASYNC_ERROR) {
+		print("error: a command was sent to a device which isn't installed\n");
+		PANIC();
+	}
+
+	print("p11 - devices not installed OK\n");
+
+	if (SYSCALL(TERMWRITE, 0, (int)p11wa, 0) != 0 ||
+			SYSCALL(TERMWRITE, 1, (int)p11wa, sizeof(p11wa) - 1) != TERMWRITE_ERROR ||
+			SYSCALL(TERMWRITE, DEV_PER_INT, (int)p11wa, sizeof(p11wa) - 1) != TERMWRITE_ERROR) {
+		print("error: wrong TERMWRITE result\n");
+		PANIC();
+	}
+
+	/* two writers on the same terminal: the second one waits for the first one */
+	p11flag = 0;
+	SYSCALL(SEMOP, (int)&term_mut, -1, 0);
+	p11child(&p11astate, (memaddr)p11write, (int)p11wa);
+	p11child(&p11bstate, (memaddr)p11write, (int)p11wb);
+	p11block(2);
+	SYSCALL(SEMOP, (int)&term_mut, 1, 0);
+	if (p11flag != 2) {
+		print("error: a TERMWRITE on a busy terminal failed\n");
+		PANIC();
+	}
+
+	print("p11 - TERMWRITE OK\n");
+
+	/* terminal 0 is in buffered mode since p10's TERMREAD: IODEVOP can't read from it */
+	if (SYSCALL(TERMREAD, 1, (int)p10line, sizeof(p10line)) != TERMREAD_ERROR ||
+			SYSCALL(TERMREAD, DEV_PER_INT, (int)p10line, sizeof(p10line)) != TERMREAD_ERROR ||
+			SYSCALL(TERMREAD, 0, (int)p10line, 0) != 0 ||
+			SYSCALL(IODEVOP, RECVCHR, INT_TERMINAL, 0x80000000) != DEV_BUSY) {
+		print("error: wrong TERMREAD result\n");
+		PANIC();
+	}
+
+	print("p11 - TERMREAD OK\n");
+
+	/* no more than IO_CQ_SIZE requests not reaped yet */
+	SYSCALL(SEMOP, (int)&term_mut, -1, 0);
+	for (i = 0; i < IO_CQ_SIZE; i++)
+		if (SYSCALL(IODEVOPASYNC, PRINTCHR | (((devregtr) p11cq[i]) << BYTELEN),
+				INT_TERMINAL, 0) != IODEVOPASYNC_OK)
+			PANIC();
+	if (SYSCALL(IODEVOPASYNC, PRINTCHR | (((devregtr) p11cq[i]) << BYTELEN),
+			INT_TERMINAL, 0) != IODEVOPASYNC_ERROR)
+		PANIC();
+	for (i = 0; i < IO_CQ_SIZE; i++)
+		p10char(p11cq[i]);
+	for (; p11cq[i] != '\0'; i++) {
+		if (SYSCALL(IODEVOPASYNC, PRINTCHR | (((devregtr) p11cq[i]) << BYTELEN),
+				INT_TERMINAL, 0) != IODEVOPASYNC_OK)
+			PANIC();
+		p10char(p11cq[i]);
+	}
+	if (SYSCALL(IOREAP, (int)&comp, TRUE, 0) != IOREAP_ERROR ||
+			SYSCALL(IODEVOPASYNC, DEV_DISK_C_SEEKCYL, INT_DISK, 1) != IODEVOPASYNC_ERROR)
+		PANIC();
+	SYSCALL(SEMOP, (int)&term_mut, 1, 0);
+
+	SYSCALL(SEMOP, (int)&endp11, 1, 0);
+
+	SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+
+	print("error: p11 didn't terminate\n");
+	PANIC();
+}
+
+/* p11mark -- a child of p11 which says it ran, then blocks */
+void p11mark() {
+	p11flag++;
+
+	SYSCALL(SEMOP, (int)&blkp11, -1, 0);
+	PANIC();
+}
+
+/* p11spin -- a CPU bound child of p11 which counts its loops in p11count[i] */
+void p11spin(int i) {
+	for (;;)
+		p11count[i]++;
+}
+
+/* p11job -- a real time child of p11, whose jobs count themselves in p11count[0] */
+void p11job(int period) {
+	if (SYSCALL(SETREALTIME, period, period / 10, 0) != 0)
+		PANIC();
+	SYSCALL(SEMOP, (int)&synp11, 1, 0);
+
+	for (;;) {
+		p11count[0]++;
+		/* the end of the job */
+		SYSCALL(WAITCLOCK, 0, 0, 0);
+	}
+}
+
+/* p11sleep -- a child of p11 which sleeps for usec, then says it woke up */
+void p11sleep(int usec) {
+	SYSCALL(SLEEP, usec, 0, 0);
+	p11seq[p11n++] = usec;
+	SYSCALL(SEMOP, (int)&synp11, 1, 0);
+
+	SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+	PANIC();
+}
+
+/* p11semv -- a child of p11 which gets p11sema and p11semb together */
+void p11semv() {
+	SYSCALL(SEMOPV, (int)p11ops, 2, 0);
+	p11flag = 1;
+	SYSCALL(SEMOP, (int)&synp11, 1, 0);
+
+	SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+	PANIC();
+}
+
+/* p11post -- a child of p11 which makes a V on p11sema after usec */
+void p11post(int usec) {
+	SYSCALL(SLEEP, usec, 0, 0);
+	SYSCALL(SEMOP, (int)&p11sema, 1, 0);
+
+	SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+	PANIC();
+}
+
+/* p11chain -- a chain of depth more processes, each the child of the previous one, */
+/* with the stack below the one of its parent                                        */
+void p11chain(int depth) {
+	state_t	state;
+
+	if (depth > 0) {
+		STST(&state);
+		state.sp -= QPAGE;
+		p11child(&state, (memaddr)p11chain, depth - 1);
+	}
+	SYSCALL(SEMOP, (int)&synp11, 1, 0);
+
+	SYSCALL(SEMOP, (int)&blkp11, -1, 0);
+	PANIC();
+}
+
+/* p11trap -- a child of p11 which defines a SYS handler or, if exit, leaves a trap */
+/* without having one                                                              */
+void p11trap(int exit) {
+	if (exit) {
+		SYSCALL(EXITTRAP, EXCP_SYS_OLD, 0, 0);
+		p11flag = 1;
+	}
+	else
+		SYSCALL(SPECSYSHDL, (memaddr)p11mark, p11bstate.sp, p5hdlflags);
+	SYSCALL(SEMOP, (int)&synp11, 1, 0);
+
+	SYSCALL(SEMOP, (int)&blkp11, -1, 0);
+	PANIC();
+}
+
+/* p11dirty -- a child of p11 which sets up as much of its pcb as it can, then blocks */
+void p11dirty() {
+	struct io_completion	comp;
+	cpu_t	time;
+
+	SYSCALL(SPECSYSHDL, (memaddr)p11mark, p11bstate.sp, p5hdlflags);
+
+	if (SYSCALL(IODEVOPASYNC, PRINTCHR | (((devregtr) '\n') << BYTELEN),
+			INT_TERMINAL, 0) != IODEVOPASYNC_OK)
+		PANIC();
+	SYSCALL(IOREAP, (int)&comp, TRUE, 0);
+
+	time = getTODLO();
+	while (getTODLO() - time < CLOCKINTERVAL / 2)
+		;
+	SYSCALL(SEMOP, (int)&synp11, 1, 0);
+
+	SYSCALL(SEMOP, (int)&blkp11, -1, 0);
+	PANIC();
+}
+
+/* p11clean -- a child of p11 which checks it starts from scratch, then blocks */
+void p11clean() {
+	struct io_completion	comp;
+	cpu_t	glob, usr;
+	int		clean;
+
+	SYSCALL(GETCPUTIME, (int)&glob, (int)&usr, 0);
+	clean = glob < CLOCKINTERVAL / 4 && SYSCALL(IOREAP, (int)&comp, TRUE, 0) == IOREAP_ERROR;
+	/* it would be killed if a handler was already defined */
+	SYSCALL(SPECSYSHDL, (memaddr)p11mark, p11bstate.sp, p5hdlflags);
+	p11flag = clean;
+
+	SYSCALL(SEMOP, (int)&blkp11, -1, 0);
+	PANIC();
+}
+
+/* p11wait -- a child of p11 which says when it got p11sema */
+void p11wait(int n) {
+	SYSCALL(SEMOP, (int)&p11sema, -1, 0);
+	p11seq[p11n++] = n;
+	SYSCALL(SEMOP, (int)&synp11, 1, 0);
+
+	SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+	PANIC();
+}
+
+/* p11tick -- a child of p11 which says when it woke up from a WAITCLOCK */
+void p11tick() {
+	SYSCALL(WAITCLOCK, 0, 0, 0);
+	p11seq[p11n++] = getTODLO();
+	SYSCALL(SEMOP, (int)&synp11, 1, 0);
+
+	SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+	PANIC();
+}
+
+/* p11write -- a child of p11 which writes the string s on terminal 0 */
+void p11write(char *s) {
+	int		n;
+
+	for (n = 0; s[n] != '\0'; n++)
+		;
+	if (SYSCALL(TERMWRITE, 0, (int)s, n) == n)
+		p11flag++;
+	SYSCALL(SEMOP, (int)&synp11, 1, 0);
+
+	SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+	PANIC();
+}
+
+/* p11hog -- a CPU bound child of p11 with the top priority */
+void p11hog() {
+	SYSCALL(SETPRIORITY, SCHED_PRIO_MAX, 0, 0);
+	p11flag = 1;
+
+	for (;;)
+		;
+}